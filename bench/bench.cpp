@@ -0,0 +1,418 @@
+#include "synthetic.h"
+#include "bookmark_db.h"
+#include "bookmark_import.h"
+#include "bookmark_journal.h"
+#include "overlay_layout.h"
+#include "bookmark_clusters.h"
+#include "overlay_worker.h"
+#include "bookmark_filter.h"
+#include "bookmark_search.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Headless benchmark of the bookmark manager: overlay layout and drawing,
+// label hit-testing, schedule evaluation and the load/save/import paths, run
+// against generated bookmarks. Prints the median of each measurement as CSV.
+
+// Counts allocations, to check that an unchanged frame makes none
+namespace {
+    // Atomic as the layout worker allocates on its own thread
+    std::atomic<size_t> allocations { 0 };
+}
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* ptr = std::malloc(size ? size : 1)) { return ptr; }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+    // Monday 2024-01-01 12:00 UTC, fixed so schedules evaluate the same way on every run
+    constexpr int64_t BENCH_EPOCH_MINUTE = 28401120 + 720;
+
+    struct Options {
+        std::vector<size_t> counts = { 1000, 10000, 100000, 1000000 };
+        std::vector<double> zooms = { 1.0, 0.1, 0.01, 0.001 };
+        int repeats = 5;
+        int rows = 5;
+        std::string tmpDir = std::filesystem::temp_directory_path().string();
+        bool io = true;
+        SyntheticOptions synthetic;
+    };
+
+    double median(std::vector<double> samples) {
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+
+    // Runs `fn` once to warm up, then `repeats` times, and returns the median in ms
+    double measure(int repeats, const std::function<void()>& fn) {
+        fn();
+        std::vector<double> samples;
+        for (int i = 0; i < repeats; i++) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        return median(samples);
+    }
+
+    void report(size_t count, const char* name, double zoom, double ms, size_t items) {
+        printf("%zu,%s,%g,%.4f,%zu\n", count, name, zoom, ms, items);
+        fflush(stdout);
+    }
+
+    struct Waterfall {
+        std::vector<WaterfallBookmark> bookmarks;
+        FrequencyIndex index;
+    };
+
+    // Same as refreshWaterfallBookmarks() in the module
+    void buildWaterfall(const BookmarkStore& store, Waterfall& wf) {
+        wf.bookmarks.clear();
+        for (BookmarkId id = 0; id < store.capacity(); id++) {
+            if (!store.valid(id)) { continue; }
+            WaterfallBookmark wbm;
+            wbm.id = id;
+            wbm.color = store.color(id);
+            wbm.frequency = store.frequency(id);
+            wbm.nameSize = measureLabel(ImGui::GetFont(), ImGui::GetFontSize(), store.name(id));
+            wbm.nameLength = strlen(store.name(id));
+            wf.bookmarks.push_back(wbm);
+        }
+        std::sort(wf.bookmarks.begin(), wf.bookmarks.end(), [](const WaterfallBookmark& a, const WaterfallBookmark& b) {
+            return a.frequency < b.frequency;
+        });
+        wf.index.clear();
+        wf.index.reserve(wf.bookmarks.size());
+        for (auto const& wbm : wf.bookmarks) {
+            wf.index.push(wbm.frequency);
+        }
+    }
+
+    void benchOverlay(const Options& opts, size_t count, const BookmarkStore& store, const ScheduleEngine& schedule, Waterfall& wf) {
+        const SyntheticOptions& syn = opts.synthetic;
+        OverlayOptions layoutOpts;
+        layoutOpts.top = false;
+        layoutOpts.rows = opts.rows;
+        layoutOpts.rectangle = true;
+        layoutOpts.centered = false;
+        layoutOpts.noClutter = true;
+        layoutOpts.fontSize = ImGui::GetFontSize();
+        measureDigits(layoutOpts, ImGui::GetFont());
+
+        ClusterHierarchy clusters;
+        double ms = measure(opts.repeats, [&]() {
+            clusters.build(store, wf.bookmarks);
+        });
+        report(count, "cluster_build", 0, ms, clusters.levelCount());
+        report(count, "cluster_bytes", 0, 0, clusters.memoryUsage());
+
+        BookmarkFilter filter;
+        ms = measure(opts.repeats, [&]() {
+            filter.build(store, wf.bookmarks);
+        });
+        report(count, "filter_build", 0, ms, wf.bookmarks.size());
+
+        // On air bookmarks of one mode, another mode on each run so the result isn't reused
+        OverlayFilter overlayFilter;
+        overlayFilter.onlineOnly = true;
+        int filterMode = 0;
+        ms = measure(opts.repeats, [&]() {
+            overlayFilter.modes = 1u << (filterMode++ % 8);
+            filter.apply(store, schedule, wf.bookmarks, overlayFilter);
+        });
+        report(count, "filter_apply", 0, ms, filter.bookmarks().size());
+        report(count, "filter_bytes", 0, 0, filter.memoryUsage());
+
+        OverlayWorker worker;
+        auto snapshot = std::make_shared<OverlaySnapshot>();
+        snapshot->bookmarks = wf.bookmarks;
+        snapshot->index = wf.index;
+        auto states = std::make_shared<const ScheduleEngine>(schedule.statesCopy());
+
+        for (double zoom : opts.zooms) {
+            // A view of 1920x300 pixels centered on the median bookmark, so
+            // narrow views still land among bookmarks
+            OverlayView view;
+            view.min = ImVec2(0, 0);
+            view.max = ImVec2(1920, 300);
+            double center = wf.bookmarks.empty() ? (syn.lowFreq + syn.highFreq) / 2.0 : store.frequency(wf.bookmarks[wf.bookmarks.size() / 2].id);
+            double span = (syn.highFreq - syn.lowFreq) * zoom;
+            view.lowFreq = center - span / 2.0;
+            view.highFreq = center + span / 2.0;
+            view.freqToPixelRatio = (view.max.x - view.min.x) / span;
+
+            OverlayLayout clustered;
+            ms = measure(opts.repeats, [&]() {
+                clustered.layout(schedule, wf.bookmarks, wf.index, view, layoutOpts, &clusters);
+            });
+            report(count, "layout_clustered", zoom, ms, clustered.commands().size() + clustered.clusterCommands().size());
+
+            OverlayLayout overlay;
+            ms = measure(opts.repeats, [&]() {
+                overlay.layout(schedule, wf.bookmarks, wf.index, view, layoutOpts);
+            });
+            report(count, "layout", zoom, ms, overlay.commands().size());
+
+            // The cheapest look before grouping, as the frame budget falls back to
+            OverlayOptions tickOpts = layoutOpts;
+            tickOpts.rectangle = false;
+            tickOpts.text = false;
+            tickOpts.ticks = true;
+            tickOpts.rows = 0;
+            OverlayLayout ticks;
+            ms = measure(opts.repeats, [&]() {
+                ticks.layout(schedule, wf.bookmarks, wf.index, view, tickOpts);
+            });
+            report(count, "layout_ticks", zoom, ms, ticks.commands().size());
+
+            ImDrawList drawList;
+            ms = measure(opts.repeats, [&]() {
+                drawList.clear();
+                overlay.draw(&drawList, store, layoutOpts.rectangle);
+            });
+            report(count, "draw", zoom, ms, drawList.rects + drawList.lines + drawList.texts);
+            report(count, "draw_buffer_growths", zoom, 0, drawList.growths);
+
+            // A frame after the first: the same layout done again and drawn
+            size_t before = allocations;
+            overlay.layout(schedule, wf.bookmarks, wf.index, view, layoutOpts);
+            drawList.clear();
+            overlay.draw(&drawList, store, layoutOpts.rectangle);
+            report(count, "frame_allocations", zoom, 0, allocations - before);
+
+            // From handing the view to the layout worker to its layout being ready
+            ms = measure(opts.repeats, [&]() {
+                worker.request(snapshot, states, view, layoutOpts);
+                while (!worker.acquire()) { std::this_thread::yield(); }
+            });
+            report(count, "layout_worker", zoom, ms, worker.front()->layout.commands().size());
+
+            // Mouse positions spread over the whole view
+            constexpr int HIT_TESTS = 100000;
+            std::mt19937 rnd(opts.synthetic.seed);
+            std::vector<ImVec2> points;
+            for (int i = 0; i < HIT_TESTS; i++) {
+                points.push_back(ImVec2(rnd() % 1920, rnd() % 300));
+            }
+            size_t hits = 0;
+            ms = measure(opts.repeats, [&]() {
+                hits = 0;
+                for (auto const& p : points) {
+                    hits += (overlay.find(p.x, p.y) != LabelHitIndex::NONE);
+                }
+            });
+            report(count, "hit_test_100k", zoom, ms, hits);
+        }
+    }
+
+    void benchSchedule(const Options& opts, size_t count, const BookmarkStore& store, ScheduleEngine& schedule) {
+        double ms = measure(opts.repeats, [&]() {
+            schedule.invalidateAll();
+            schedule.update(store, BENCH_EPOCH_MINUTE);
+        });
+        report(count, "schedule_full", 0, ms, count);
+
+        // One update per minute over a day, as the waterfall does
+        ms = measure(opts.repeats, [&]() {
+            schedule.invalidateAll();
+            schedule.update(store, BENCH_EPOCH_MINUTE);
+            for (int64_t minute = 1; minute <= 1440; minute++) {
+                schedule.update(store, BENCH_EPOCH_MINUTE + minute);
+            }
+        });
+        report(count, "schedule_day", 0, ms, count);
+
+        ms = measure(opts.repeats, [&]() {
+            size_t online = 0;
+            for (BookmarkId id = 0; id < store.capacity(); id++) {
+                if (!store.valid(id)) { continue; }
+                online += bookmarkOnlineAt(store.startTime(id), store.endTime(id), store.days(id), BENCH_EPOCH_MINUTE);
+            }
+            if (online > count) { abort(); }
+        });
+        report(count, "bookmark_online_scan", 0, ms, count);
+    }
+
+    void benchPersistence(const Options& opts, size_t count, const BookmarkStore& store) {
+        std::string base = opts.tmpDir + "/bookmark_manager_bench_" + std::to_string(count);
+        std::string dbPath = base + ".db";
+        std::string journalPath = base + ".journal";
+        std::string jsonPath = base + ".json";
+        std::string error;
+
+        double ms = measure(opts.repeats, [&]() {
+            if (!BookmarkDatabase::save(store, dbPath, error)) {
+                fprintf(stderr, "save failed: %s\n", error.c_str());
+                exit(1);
+            }
+        });
+        report(count, "db_save", 0, ms, (size_t)std::filesystem::file_size(dbPath));
+
+        BookmarkStore loaded;
+        ms = measure(opts.repeats, [&]() {
+            if (!BookmarkDatabase::load(loaded, dbPath, error)) {
+                fprintf(stderr, "load failed: %s\n", error.c_str());
+                exit(1);
+            }
+        });
+        report(count, "db_load", 0, ms, count);
+
+        // Appending single edits, each made durable as the module does
+        constexpr int JOURNAL_EDITS = 200;
+        ms = measure(opts.repeats, [&]() {
+            std::filesystem::remove(journalPath);
+            EditJournal journal;
+            size_t replayed;
+            BookmarkStore scratch;
+            if (!journal.open(journalPath, scratch, 0, replayed, error)) {
+                fprintf(stderr, "journal failed: %s\n", error.c_str());
+                exit(1);
+            }
+            FrequencyBookmark bm = store.get(0);
+            for (int i = 0; i < JOURNAL_EDITS; i++) {
+                journal.updateBookmark("List 0", "edited", "edited", bm);
+                journal.sync();
+            }
+            journal.close();
+        });
+        report(count, "journal_200_edits", 0, ms, JOURNAL_EDITS);
+
+        // Import of the same bookmarks from a JSON bookmark file
+        {
+            json file;
+            file["bookmarks"] = json::object();
+            for (BookmarkId id = 0; id < store.capacity(); id++) {
+                if (store.valid(id)) { file["bookmarks"][store.name(id)] = bookmarkToJson(store.get(id)); }
+            }
+            std::ofstream fs(jsonPath);
+            fs << file;
+        }
+        size_t imported = 0;
+        ms = measure(opts.repeats, [&]() {
+            BookmarkImporter importer;
+            importer.start(jsonPath);
+            while (importer.running()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            BookmarkImporter::State state;
+            BookmarkImporter::Entries entries;
+            size_t skipped;
+            importer.collect(state, entries, skipped, error);
+            imported = entries.size();
+        });
+        report(count, "json_import", 0, ms, imported);
+
+        std::filesystem::remove(dbPath);
+        std::filesystem::remove(journalPath);
+        std::filesystem::remove(jsonPath);
+    }
+
+    template <class T>
+    std::vector<T> parseList(const char* arg) {
+        std::vector<T> values;
+        for (const char* p = arg; *p;) {
+            char* end;
+            values.push_back((T)strtod(p, &end));
+            p = (*end == ',') ? end + 1 : end;
+            if (end == p) { break; }
+        }
+        return values;
+    }
+
+    void usage() {
+        printf("Usage: bookmark_manager_bench [options]\n"
+               "  --counts N,N,...     bookmark counts (default 1000,10000,100000,1000000)\n"
+               "  --zooms Z,Z,...      visible fraction of the range (default 1,0.1,0.01,0.001)\n"
+               "  --lists N            number of lists (default 8)\n"
+               "  --name-length N      average name length (default 12)\n"
+               "  --distribution D     uniform or clustered (default clustered)\n"
+               "  --range LOW,HIGH     frequency range in Hz (default 500000,30000000)\n"
+               "  --rows N             label rows (default 5)\n"
+               "  --repeats N          runs per measurement (default 5)\n"
+               "  --seed N             generator seed (default 1)\n"
+               "  --tmp DIR            directory for the files written (default system temp)\n"
+               "  --no-io              skip the database, journal and import measurements\n");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char* val = (i + 1 < argc) ? argv[i + 1] : "";
+        if (arg == "--counts") { opts.counts = parseList<size_t>(val); i++; }
+        else if (arg == "--zooms") { opts.zooms = parseList<double>(val); i++; }
+        else if (arg == "--lists") { opts.synthetic.lists = atoi(val); i++; }
+        else if (arg == "--name-length") { opts.synthetic.nameLength = atoi(val); i++; }
+        else if (arg == "--rows") { opts.rows = atoi(val); i++; }
+        else if (arg == "--repeats") { opts.repeats = std::max(1, atoi(val)); i++; }
+        else if (arg == "--seed") { opts.synthetic.seed = strtoul(val, NULL, 10); i++; }
+        else if (arg == "--tmp") { opts.tmpDir = val; i++; }
+        else if (arg == "--no-io") { opts.io = false; }
+        else if (arg == "--distribution") {
+            opts.synthetic.distribution = strcmp(val, "uniform") ? SyntheticOptions::DISTRIBUTION_CLUSTERED : SyntheticOptions::DISTRIBUTION_UNIFORM;
+            i++;
+        }
+        else if (arg == "--range") {
+            std::vector<double> range = parseList<double>(val);
+            if (range.size() == 2 && range[0] < range[1]) {
+                opts.synthetic.lowFreq = range[0];
+                opts.synthetic.highFreq = range[1];
+            }
+            i++;
+        }
+        else {
+            usage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    printf("count,benchmark,zoom,median_ms,items\n");
+    for (size_t count : opts.counts) {
+        opts.synthetic.count = count;
+        BookmarkStore store;
+        auto start = std::chrono::steady_clock::now();
+        generateBookmarks(store, opts.synthetic);
+        report(count, "generate", 0, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), count);
+        report(count, "store_bytes", 0, 0, store.memoryUsage());
+
+        SearchIndex searchIndex;
+        double ms = measure(opts.repeats, [&]() { searchIndex.build(store); });
+        report(count, "search_index_build", 0, ms, count);
+        report(count, "search_index_bytes", 0, 0, searchIndex.memoryUsage());
+
+        Waterfall wf;
+        ms = measure(opts.repeats, [&]() { buildWaterfall(store, wf); });
+        report(count, "waterfall_build", 0, ms, wf.bookmarks.size());
+
+        ScheduleEngine schedule;
+        benchSchedule(opts, count, store, schedule);
+        schedule.invalidateAll();
+        schedule.update(store, BENCH_EPOCH_MINUTE);
+        benchOverlay(opts, count, store, schedule, wf);
+        if (opts.io) { benchPersistence(opts, count, store); }
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Just enough of ImGui for the overlay layout to run without a GUI. Text is
+// measured as a fixed width font and the draw list only counts what it gets.
+
+typedef unsigned int ImU32;
+
+#define IM_COL32_R_SHIFT 0
+#define IM_COL32_G_SHIFT 8
+#define IM_COL32_B_SHIFT 16
+#define IM_COL32_A_SHIFT 24
+#define IM_COL32(R, G, B, A) (((ImU32)(A) << IM_COL32_A_SHIFT) | ((ImU32)(B) << IM_COL32_B_SHIFT) | ((ImU32)(G) << IM_COL32_G_SHIFT) | ((ImU32)(R) << IM_COL32_R_SHIFT))
+
+struct ImVec2 {
+    float x, y;
+    ImVec2() : x(0.0f), y(0.0f) {}
+    ImVec2(float x, float y) : x(x), y(y) {}
+};
+
+struct ImFont {
+    float FontSize;
+
+    ImVec2 CalcTextSizeA(float size, float maxWidth, float wrapWidth, const char* textBegin, const char* textEnd = NULL, const char** remaining = NULL) const;
+};
+
+typedef unsigned short ImDrawIdx;
+
+// Only tracks sizes, to check that reserved space is enough
+template <class T>
+struct ImVector {
+    int Size = 0;
+    int Capacity = 0;
+    void reserve(int capacity) { if (capacity > Capacity) { Capacity = capacity; } }
+};
+
+struct ImDrawVert {
+    ImVec2 pos;
+    ImVec2 uv;
+    ImU32 col;
+};
+
+struct ImDrawList {
+    void AddRectFilled(const ImVec2& min, const ImVec2& max, ImU32 col, float rounding = 0.0f, int flags = 0);
+    void AddLine(const ImVec2& p1, const ImVec2& p2, ImU32 col, float thickness = 1.0f);
+    void AddText(const ImVec2& pos, ImU32 col, const char* text, const char* textEnd = NULL);
+    void clear();
+
+    size_t rects = 0;
+    size_t lines = 0;
+    size_t texts = 0;
+    size_t glyphs = 0;
+
+    // Grown by what ImGui emits for each primitive. `growths` counts the
+    // primitives that did not fit in the reserved space.
+    ImVector<ImDrawVert> VtxBuffer;
+    ImVector<ImDrawIdx> IdxBuffer;
+    size_t growths = 0;
+
+private:
+    void grow(int vtxCount, int idxCount);
+};
+
+namespace ImGui {
+    ImFont* GetFont();
+    float GetFontSize();
+    ImVec2 CalcTextSize(const char* text, const char* textEnd = NULL, bool hideAfterDoubleHash = false, float wrapWidth = -1.0f);
+}
@@ -0,0 +1,66 @@
+#include <imgui.h>
+#include <cstring>
+
+namespace {
+    ImFont font = { 13.0f };
+
+    // Average advance of the default font at its default size
+    constexpr float GLYPH_WIDTH = 7.0f;
+}
+
+void ImDrawList::AddRectFilled(const ImVec2& min, const ImVec2& max, ImU32 col, float rounding, int flags) {
+    rects++;
+    grow(4, 6);
+}
+
+void ImDrawList::AddLine(const ImVec2& p1, const ImVec2& p2, ImU32 col, float thickness) {
+    lines++;
+    grow(4, 6);
+}
+
+void ImDrawList::AddText(const ImVec2& pos, ImU32 col, const char* text, const char* textEnd) {
+    texts++;
+    size_t length = textEnd ? textEnd - text : strlen(text);
+    glyphs += length;
+    grow(4 * (int)length, 6 * (int)length);
+}
+
+void ImDrawList::clear() {
+    rects = 0;
+    lines = 0;
+    texts = 0;
+    glyphs = 0;
+    VtxBuffer.Size = 0;
+    IdxBuffer.Size = 0;
+    growths = 0;
+}
+
+void ImDrawList::grow(int vtxCount, int idxCount) {
+    VtxBuffer.Size += vtxCount;
+    IdxBuffer.Size += idxCount;
+    if (VtxBuffer.Size > VtxBuffer.Capacity || IdxBuffer.Size > IdxBuffer.Capacity) {
+        growths++;
+        VtxBuffer.reserve(VtxBuffer.Size * 2);
+        IdxBuffer.reserve(IdxBuffer.Size * 2);
+    }
+}
+
+ImVec2 ImFont::CalcTextSizeA(float size, float maxWidth, float wrapWidth, const char* textBegin, const char* textEnd, const char** remaining) const {
+    size_t len = textEnd ? textEnd - textBegin : strlen(textBegin);
+    return ImVec2(GLYPH_WIDTH * len * size / FontSize, size);
+}
+
+namespace ImGui {
+    ImFont* GetFont() {
+        return &font;
+    }
+
+    float GetFontSize() {
+        return font.FontSize;
+    }
+
+    ImVec2 CalcTextSize(const char* text, const char* textEnd, bool hideAfterDoubleHash, float wrapWidth) {
+        size_t len = textEnd ? textEnd - text : strlen(text);
+        return ImVec2(GLYPH_WIDTH * len, font.FontSize);
+    }
+}
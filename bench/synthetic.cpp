@@ -0,0 +1,84 @@
+#include "synthetic.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr int CLUSTER_COUNT = 64;
+
+    // Not std::uniform_int_distribution and friends, whose output differs
+    // between standard libraries
+    class Random {
+    public:
+        Random(uint32_t seed) : engine(seed) {}
+
+        uint32_t next(uint32_t bound) { return engine() % bound; }
+        double unit() { return (engine() >> 8) * (1.0 / 16777216.0); }
+
+        // Sum of uniforms, close enough to a normal distribution here
+        double normal() {
+            double sum = 0.0;
+            for (int i = 0; i < 12; i++) { sum += unit(); }
+            return sum - 6.0;
+        }
+
+    private:
+        std::mt19937 engine;
+    };
+
+    int randomTime(Random& rnd) {
+        return rnd.next(24) * 100 + rnd.next(4) * 15;
+    }
+}
+
+void generateBookmarks(BookmarkStore& store, const SyntheticOptions& options) {
+    Random rnd(options.seed);
+    store.clear();
+
+    std::vector<ListId> lists;
+    for (int i = 0; i < std::max<int>(options.lists, 1); i++) {
+        lists.push_back(store.addList("List " + std::to_string(i), DEFAULT_LIST_COLOR, true));
+    }
+
+    double span = options.highFreq - options.lowFreq;
+    std::vector<double> clusters;
+    for (int i = 0; i < CLUSTER_COUNT; i++) {
+        clusters.push_back(options.lowFreq + rnd.unit() * span);
+    }
+
+    static const char charset[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789 -";
+    std::string name;
+    for (size_t i = 0; i < options.count; i++) {
+        FrequencyBookmark bm;
+        if (options.distribution == SyntheticOptions::DISTRIBUTION_UNIFORM) {
+            bm.frequency = options.lowFreq + rnd.unit() * span;
+        }
+        else {
+            double center = clusters[rnd.next(CLUSTER_COUNT)];
+            bm.frequency = std::clamp(center + rnd.normal() * span / 2000.0, options.lowFreq, options.highFreq);
+        }
+        bm.frequency = std::round(bm.frequency / 100.0) * 100.0;
+        bm.bandwidth = 1000.0 * (1 + rnd.next(12));
+        bm.mode = rnd.next(8);
+        if (rnd.unit() < options.scheduledRatio) {
+            bm.startTime = randomTime(rnd);
+            bm.endTime = randomTime(rnd);
+            maskToDays(1 + rnd.next(ALL_DAYS_MASK), bm.days);
+        }
+        else {
+            bm.startTime = 0;
+            bm.endTime = 0;
+            maskToDays(ALL_DAYS_MASK, bm.days);
+        }
+
+        // A serial number keeps names unique within their list
+        int length = std::max<int>(1, options.nameLength / 2 + rnd.next(options.nameLength + 1));
+        name = std::to_string(i) + ' ';
+        while ((int)name.size() < length) {
+            name += charset[rnd.next(sizeof(charset) - 1)];
+        }
+
+        store.add(lists[rnd.next(lists.size())], name, bm);
+    }
+}
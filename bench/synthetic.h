@@ -0,0 +1,25 @@
+#pragma once
+#include "bookmark_store.h"
+#include <cstdint>
+#include <string>
+
+// Parameters of a generated bookmark set. The same options always give the
+// same bookmarks, so timings can be compared between builds.
+struct SyntheticOptions {
+    enum Distribution {
+        DISTRIBUTION_UNIFORM, // Spread evenly over the range
+        DISTRIBUTION_CLUSTERED // Grouped around a few band centers, like real bookmark files
+    };
+
+    size_t count = 10000;
+    int lists = 8;
+    double lowFreq = 500e3;
+    double highFreq = 30e6;
+    Distribution distribution = DISTRIBUTION_CLUSTERED;
+    int nameLength = 12; // Average, names vary from half to one and a half times this
+    float scheduledRatio = 0.3f; // Bookmarks with on air times instead of always on
+    uint32_t seed = 1;
+};
+
+// Fills the store with lists named "List 0", "List 1" and so on
+void generateBookmarks(BookmarkStore& store, const SyntheticOptions& options);
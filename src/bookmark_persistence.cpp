@@ -0,0 +1,202 @@
+#include "bookmark_persistence.h"
+#include "bookmark_db.h"
+#include <utils/flog.h>
+#include <chrono>
+
+namespace {
+    // Journal size past which it gets folded into the database
+    constexpr size_t JOURNAL_COMPACT_SIZE = 4 << 20;
+
+    // Least time between database writes when the journal is closed
+    constexpr std::chrono::seconds SNAPSHOT_INTERVAL(1);
+}
+
+#ifdef BOOKMARK_MANAGER_DIAGNOSTICS
+namespace {
+    // Timings kept for reportDiagnostics() when the UI doesn't pick them up
+    constexpr size_t MAX_TIMINGS = 1024;
+}
+
+// Times work on the persistence thread, diag is only fed from the UI thread
+class BookmarkPersistence::WorkTimer {
+public:
+    WorkTimer(BookmarkPersistence* owner, diag::Timer timer) : owner(owner), timer(timer), start(std::chrono::steady_clock::now()) {}
+
+    ~WorkTimer() {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::lock_guard<std::mutex> lck(owner->timingsMtx);
+        if (owner->timings.size() < MAX_TIMINGS) { owner->timings.emplace_back(timer, ms); }
+    }
+
+private:
+    BookmarkPersistence* owner;
+    diag::Timer timer;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define WORK_TIMER(timer) WorkTimer _workTimer(this, timer)
+#else
+#define WORK_TIMER(timer)
+#endif
+
+BookmarkPersistence::~BookmarkPersistence() {
+    if (workerThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            stopWorker = true;
+        }
+        queueCnd.notify_all();
+        workerThread.join();
+    }
+    _journal.close();
+}
+
+bool BookmarkPersistence::open(const std::string& dbPath, const std::string& journalPath, BookmarkStore& store, uint64_t dbSequence, size_t& replayed, std::string& error) {
+    this->dbPath = dbPath;
+    journalOpen = _journal.open(journalPath, store, dbSequence, replayed, error);
+    stopWorker = false;
+    workerThread = std::thread(&BookmarkPersistence::worker, this);
+
+    // Recovered edits go into the database right away
+    if (replayed > 0) { snapshot(store); }
+    return journalOpen;
+}
+
+void BookmarkPersistence::close(const BookmarkStore& store) {
+    if (!workerThread.joinable()) { return; }
+    if (journalBytes > 0 || _journal.hasPending()) { snapshot(store); }
+    {
+        std::lock_guard<std::mutex> lck(queueMtx);
+        stopWorker = true;
+    }
+    queueCnd.notify_all();
+    workerThread.join();
+    _journal.close();
+}
+
+void BookmarkPersistence::commit(const BookmarkStore& store) {
+    DIAG_SCOPE(diag::TIMER_PERSISTENCE_STALL);
+    if (!journalOpen) {
+        // Every edit would rewrite the database, only the latest copy of the
+        // store is kept until the next write is due
+        _journal.takePending();
+        {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            pendingSnapshot = store;
+            pendingSequence = _journal.sequence();
+        }
+        queueCnd.notify_one();
+        return;
+    }
+    writeRecords();
+    if (journalBytes > JOURNAL_COMPACT_SIZE) { snapshot(store); }
+}
+
+void BookmarkPersistence::compact(const BookmarkStore& store) {
+    DIAG_SCOPE(diag::TIMER_PERSISTENCE_STALL);
+    snapshot(store);
+}
+
+void BookmarkPersistence::post(std::function<void()> task) {
+    DIAG_SCOPE(diag::TIMER_PERSISTENCE_STALL);
+    enqueue(std::move(task));
+}
+
+#ifdef BOOKMARK_MANAGER_DIAGNOSTICS
+void BookmarkPersistence::reportDiagnostics() {
+    std::vector<std::pair<diag::Timer, double>> done;
+    {
+        std::lock_guard<std::mutex> lck(timingsMtx);
+        done.swap(timings);
+    }
+    for (const auto& [timer, ms] : done) { diag::record(timer, ms); }
+    diag::count(diag::COUNTER_PERSISTENCE_QUEUED, queued);
+    diag::count(diag::COUNTER_JOURNAL_KB, journalBytes / 1024);
+}
+#endif
+
+void BookmarkPersistence::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lck(queueMtx);
+        queue.push_back(std::move(task));
+#ifdef BOOKMARK_MANAGER_DIAGNOSTICS
+        queued++;
+#endif
+    }
+    queueCnd.notify_one();
+}
+
+void BookmarkPersistence::writeRecords() {
+    std::vector<uint8_t> records = _journal.takePending();
+    if (records.empty()) { return; }
+    journalBytes += records.size();
+    enqueue([this, records = std::move(records)]() {
+        WORK_TIMER(diag::TIMER_JOURNAL_WRITE);
+        if (!_journal.write(records)) {
+            flog::error("Could not write the bookmark journal");
+        }
+    });
+}
+
+void BookmarkPersistence::snapshot(const BookmarkStore& store) {
+    // The records are written first so the edits stay on disk even if
+    // writing the database fails
+    if (journalOpen) { writeRecords(); }
+    else { _journal.takePending(); }
+    journalBytes = 0;
+
+    uint64_t sequence = _journal.sequence();
+    {
+        // This copy is newer than any waiting one
+        std::lock_guard<std::mutex> lck(queueMtx);
+        pendingSnapshot.reset();
+    }
+    enqueue([this, copy = store, sequence]() { saveDatabase(copy, sequence); });
+}
+
+void BookmarkPersistence::saveDatabase(const BookmarkStore& copy, uint64_t sequence) {
+    WORK_TIMER(diag::TIMER_DATABASE_WRITE);
+    std::string error;
+    if (!BookmarkDatabase::save(copy, dbPath, error, sequence)) {
+        flog::error("Could not save the bookmark database: {0}", error);
+        return;
+    }
+    if (journalOpen && !_journal.truncate(error)) {
+        flog::error("Could not trim the bookmark journal: {0}", error);
+    }
+}
+
+void BookmarkPersistence::worker() {
+    while (true) {
+        std::function<void()> task;
+        std::optional<BookmarkStore> copy;
+        uint64_t sequence = 0;
+        {
+            std::unique_lock<std::mutex> lck(queueMtx);
+            while (queue.empty()) {
+                // A waiting copy is written when due, or right away when stopping
+                if (pendingSnapshot && (stopWorker || std::chrono::steady_clock::now() >= nextSnapshot)) {
+                    copy.swap(pendingSnapshot);
+                    sequence = pendingSequence;
+                    nextSnapshot = std::chrono::steady_clock::now() + SNAPSHOT_INTERVAL;
+                    break;
+                }
+                if (stopWorker) { return; }
+                if (pendingSnapshot) { queueCnd.wait_until(lck, nextSnapshot); }
+                else { queueCnd.wait(lck); }
+            }
+            if (!copy) {
+                task = std::move(queue.front());
+                queue.pop_front();
+            }
+        }
+        if (copy) {
+            saveDatabase(*copy, sequence);
+            continue;
+        }
+        task();
+#ifdef BOOKMARK_MANAGER_DIAGNOSTICS
+        queued--;
+#endif
+    }
+}
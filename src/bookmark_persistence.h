@@ -0,0 +1,89 @@
+#pragma once
+#include "bookmark_store.h"
+#include "bookmark_journal.h"
+#include "diagnostics.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes the bookmark database and journal on a thread of its own. The UI
+// thread only encodes journal records and copies the store, which shares its
+// columns with the copy until the next edit, so it never waits on the disk.
+//
+// Work is done in the order it was handed over: journal records, database
+// snapshots, and any task posted with post(). Copies of the store waiting
+// while the journal is closed are written once nothing else is queued.
+class BookmarkPersistence {
+public:
+    ~BookmarkPersistence();
+
+    // Opens the journal, replays into the store the edits the database doesn't
+    // have yet, then starts the thread. The thread is started even if the
+    // journal can't be opened, edits then rewrite the whole database instead,
+    // coalesced to at most one write per second. Like EditJournal::open(),
+    // `error` may be set on success when a damaged journal was moved aside.
+    bool open(const std::string& dbPath, const std::string& journalPath, BookmarkStore& store, uint64_t dbSequence, size_t& replayed, std::string& error);
+
+    // Finishes the queued work, folds the journal into the database and
+    // stops the thread
+    void close(const BookmarkStore& store);
+
+    // For recording edits before they are applied to the store
+    EditJournal& journal() { return _journal; }
+
+    // Hands the recorded edits over. Once the journal has grown large, a
+    // snapshot of the store goes to the database as well.
+    void commit(const BookmarkStore& store);
+
+    // Writes a snapshot of the store to the database and empties the journal
+    void compact(const BookmarkStore& store);
+
+    // Runs a task on the persistence thread
+    void post(std::function<void()> task);
+
+#ifdef BOOKMARK_MANAGER_DIAGNOSTICS
+    // Hands the timings taken on the persistence thread since the last call
+    // over to diag, to be called once per frame from the UI thread
+    void reportDiagnostics();
+#endif
+
+private:
+    void enqueue(std::function<void()> task);
+    void writeRecords();
+    void snapshot(const BookmarkStore& store);
+    void saveDatabase(const BookmarkStore& copy, uint64_t sequence);
+    void worker();
+
+    std::string dbPath;
+    EditJournal _journal;
+    bool journalOpen = false;
+    size_t journalBytes = 0;
+
+    std::thread workerThread;
+    std::mutex queueMtx;
+    std::condition_variable queueCnd;
+    std::deque<std::function<void()>> queue;
+    bool stopWorker = false;
+
+    // Latest copy of the store while the journal is closed, written once
+    // nextSnapshot has passed. Guarded by queueMtx.
+    std::optional<BookmarkStore> pendingSnapshot;
+    uint64_t pendingSequence = 0;
+    std::chrono::steady_clock::time_point nextSnapshot;
+
+#ifdef BOOKMARK_MANAGER_DIAGNOSTICS
+    class WorkTimer;
+
+    // Timings taken on the persistence thread, waiting for reportDiagnostics()
+    std::mutex timingsMtx;
+    std::vector<std::pair<diag::Timer, double>> timings;
+    std::atomic<size_t> queued { 0 };
+#endif
+};
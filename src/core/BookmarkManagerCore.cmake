@@ -0,0 +1,26 @@
+# The bookmark manager core: bookmark store, schedules, database, journal,
+# import and overlay layout. It doesn't depend on SDR++. The overlay layout
+# uses ImGui for its types, text measuring and drawing. The headers come from
+# the include directories given here, and the symbols from whatever links the
+# library: SDR++ core for the module, a stub for the benchmark.
+
+set(BOOKMARK_MANAGER_CORE_DIR "${CMAKE_CURRENT_LIST_DIR}")
+
+# add_bookmark_manager_core(<name> <include directories of imgui.h and json.hpp>...)
+function(add_bookmark_manager_core name)
+    file(GLOB CORE_SRC "${BOOKMARK_MANAGER_CORE_DIR}/*.cpp")
+    add_library(${name} STATIC ${CORE_SRC})
+    set_target_properties(${name} PROPERTIES POSITION_INDEPENDENT_CODE ON)
+    target_include_directories(${name} PUBLIC "${BOOKMARK_MANAGER_CORE_DIR}" ${ARGN})
+
+    find_package(Threads REQUIRED)
+    target_link_libraries(${name} PUBLIC Threads::Threads)
+
+    if (MSVC)
+        target_compile_options(${name} PRIVATE /O2 /Ob2 /std:c++17 /EHsc)
+    elseif (CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+        target_compile_options(${name} PRIVATE -O3 -std=c++17 -Wno-unused-command-line-argument)
+    else ()
+        target_compile_options(${name} PRIVATE -O3 -std=c++17)
+    endif ()
+endfunction()
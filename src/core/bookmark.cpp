@@ -0,0 +1,72 @@
+#include "bookmark.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <stdexcept>
+
+uint32_t hexStrToColor(const std::string& col) {
+    if (col.size() != 7 || col[0] != '#' || !std::all_of(col.begin() + 1, col.end(), ::isxdigit)) {
+        return DEFAULT_LIST_COLOR;
+    }
+    uint32_t r = std::stoi(col.substr(1, 2), NULL, 16);
+    uint32_t g = std::stoi(col.substr(3, 2), NULL, 16);
+    uint32_t b = std::stoi(col.substr(5, 2), NULL, 16);
+    return (0xFFu << 24) | (b << 16) | (g << 8) | r;
+}
+
+std::string colorToHexStr(uint32_t col) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "#%02X%02X%02X", (int)(col & 0xFF), (int)((col >> 8) & 0xFF), (int)((col >> 16) & 0xFF));
+    return buf;
+}
+
+FrequencyBookmark bookmarkFromJson(const json& bm) {
+    FrequencyBookmark fbm;
+    fbm.frequency = bm["frequency"];
+    fbm.bandwidth = bm["bandwidth"];
+    fbm.startTime = bm.contains("startTime") ? (int)bm["startTime"] : 0;
+    fbm.endTime = bm.contains("endTime") ? (int)bm["endTime"] : 0;
+
+    if (bm.contains("days")) {
+        const json& days = bm["days"];
+        if (!days.is_array() || days.size() != 7) {
+            throw std::out_of_range("days must hold 7 entries");
+        }
+        std::copy(days.begin(), days.end(), fbm.days);
+    } else {
+        for (int i = 0; i < 7; i++) {
+            fbm.days[i] = true;
+        }
+    }
+
+    if (bm.contains("geoinfo")) {
+        fbm.geoinfo = bm["geoinfo"];
+    } else {
+        fbm.geoinfo = "";
+    }
+
+    if (bm.contains("notes")) {
+        fbm.notes = bm["notes"];
+    } else {
+        fbm.notes = "";
+    }
+
+    fbm.mode = bm["mode"];
+    if (fbm.mode < 0 || fbm.mode >= BOOKMARK_MODE_COUNT) {
+        throw std::out_of_range("Unknown mode " + std::to_string(fbm.mode));
+    }
+    return fbm;
+}
+
+json bookmarkToJson(const FrequencyBookmark& bm) {
+    json j;
+    j["frequency"] = bm.frequency;
+    j["bandwidth"] = bm.bandwidth;
+    j["startTime"] = bm.startTime;
+    j["endTime"] = bm.endTime;
+    j["days"] = bm.days;
+    j["geoinfo"] = bm.geoinfo;
+    j["notes"] = bm.notes;
+    j["mode"] = bm.mode;
+    return j;
+}
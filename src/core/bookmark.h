@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <json.hpp>
+
+using nlohmann::json;
+
+struct FrequencyBookmark {
+    double frequency;
+    double bandwidth;
+    int mode;
+    int startTime;
+    int endTime;
+    bool days[7];
+    std::string notes;
+    std::string geoinfo;
+};
+
+// Week days packed into the low 7 bits, bit 0 being Sunday
+inline uint8_t daysToMask(const bool days[7]) {
+    uint8_t mask = 0;
+    for (int i = 0; i < 7; i++) {
+        if (days[i]) { mask |= (1 << i); }
+    }
+    return mask;
+}
+
+inline void maskToDays(uint8_t mask, bool days[7]) {
+    for (int i = 0; i < 7; i++) {
+        days[i] = (mask >> i) & 1;
+    }
+}
+
+constexpr uint8_t ALL_DAYS_MASK = 0x7F;
+
+// Demodulator modes of the radio module: NFM, WFM, AM, DSB, USB, CW, LSB, RAW
+constexpr int BOOKMARK_MODE_COUNT = 8;
+
+// List colors are packed like ImGui's IM_COL32, red in the low byte
+constexpr uint32_t DEFAULT_LIST_COLOR = 0xFF00FFFF;
+
+// "#RRGGBB" to a packed color, DEFAULT_LIST_COLOR if the string isn't one
+uint32_t hexStrToColor(const std::string& col);
+std::string colorToHexStr(uint32_t col);
+
+// Conversion from and to the JSON layout used by the config and bookmark files.
+// bookmarkFromJson requires frequency, bandwidth and mode to be present and
+// throws a json exception when a field has the wrong type, or
+// std::out_of_range when days doesn't hold 7 entries or mode isn't one of the
+// BOOKMARK_MODE_COUNT modes.
+FrequencyBookmark bookmarkFromJson(const json& bm);
+json bookmarkToJson(const FrequencyBookmark& bm);
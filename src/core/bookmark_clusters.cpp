@@ -0,0 +1,133 @@
+#include "bookmark_clusters.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    // Enough octaves to merge any pair of frequencies a double can hold as an int64 bucket
+    constexpr int MAX_LEVELS = 62;
+
+    int64_t parentBucket(int64_t bucket) {
+        return (bucket >= 0) ? bucket / 2 : (bucket - 1) / 2;
+    }
+
+    // Adds the colors of `src` to `dst`, keeping the most common ones
+    void mergeColors(BookmarkCluster& dst, const ImU32* colors, const uint32_t* counts) {
+        ImU32 mergedColors[2 * CLUSTER_COLORS];
+        uint32_t mergedCounts[2 * CLUSTER_COLORS];
+        int n = 0;
+        for (int i = 0; i < CLUSTER_COLORS && dst.colorCounts[i]; i++) {
+            mergedColors[n] = dst.colors[i];
+            mergedCounts[n++] = dst.colorCounts[i];
+        }
+        for (int i = 0; i < CLUSTER_COLORS && counts[i]; i++) {
+            int j = 0;
+            while (j < n && mergedColors[j] != colors[i]) { j++; }
+            if (j == n) {
+                mergedColors[n] = colors[i];
+                mergedCounts[n++] = 0;
+            }
+            mergedCounts[j] += counts[i];
+        }
+
+        // Insertion sort by count, the arrays are tiny
+        for (int i = 1; i < n; i++) {
+            for (int j = i; j > 0 && mergedCounts[j] > mergedCounts[j - 1]; j--) {
+                std::swap(mergedCounts[j], mergedCounts[j - 1]);
+                std::swap(mergedColors[j], mergedColors[j - 1]);
+            }
+        }
+        for (int i = 0; i < CLUSTER_COLORS; i++) {
+            dst.colors[i] = (i < n) ? mergedColors[i] : 0;
+            dst.colorCounts[i] = (i < n) ? mergedCounts[i] : 0;
+        }
+    }
+
+    void mergeCluster(BookmarkCluster& dst, const BookmarkCluster& src) {
+        uint32_t count = dst.count + src.count;
+        dst.frequency = (dst.frequency * dst.count + src.frequency * src.count) / count;
+        dst.count = count;
+        mergeColors(dst, src.colors, src.colorCounts);
+    }
+}
+
+void ClusterHierarchy::build(const BookmarkStore& store, const std::vector<WaterfallBookmark>& bookmarks) {
+    clear();
+    if (bookmarks.empty()) { return; }
+
+    // Finest level, 1 Hz buckets
+    Level base;
+    base.width = 1.0;
+    for (size_t i = 0; i < bookmarks.size(); i++) {
+        double frequency = store.frequency(bookmarks[i].id);
+        int64_t bucket = (int64_t)std::floor(frequency);
+
+        BookmarkCluster single = {};
+        single.first = (uint32_t)i;
+        single.count = 1;
+        single.frequency = frequency;
+        single.colors[0] = bookmarks[i].color;
+        single.colorCounts[0] = 1;
+
+        if (!buckets.empty() && buckets.back() == bucket) {
+            mergeCluster(base.clusters.back(), single);
+            continue;
+        }
+        base.clusters.push_back(single);
+        buckets.push_back(bucket);
+    }
+    levels.push_back(std::move(base));
+
+    // Each level merges neighbours of the previous one that share a parent bucket
+    std::vector<BookmarkCluster> merged;
+    for (int k = 1; k < MAX_LEVELS && levels.back().clusters.size() > 1; k++) {
+        const std::vector<BookmarkCluster>& below = levels.back().clusters;
+        merged.clear();
+        size_t bucketCount = 0;
+        for (size_t i = 0; i < below.size(); i++) {
+            int64_t bucket = parentBucket(buckets[i]);
+            if (bucketCount > 0 && buckets[bucketCount - 1] == bucket) {
+                mergeCluster(merged.back(), below[i]);
+                continue;
+            }
+            merged.push_back(below[i]);
+            buckets[bucketCount++] = bucket;
+        }
+        buckets.resize(bucketCount);
+
+        double width = std::ldexp(1.0, k);
+        if (merged.size() == below.size()) {
+            levels.back().width = width;
+            continue;
+        }
+        Level level;
+        level.width = width;
+        level.clusters = merged;
+        levels.push_back(std::move(level));
+    }
+
+    // The coarsest level serves any wider request
+    levels.back().width = std::numeric_limits<double>::infinity();
+    buckets.clear();
+}
+
+void ClusterHierarchy::clear() {
+    levels.clear();
+    buckets.clear();
+}
+
+const std::vector<BookmarkCluster>& ClusterHierarchy::level(double minWidth) const {
+    static const std::vector<BookmarkCluster> empty;
+    for (auto const& level : levels) {
+        if (level.width >= minWidth) { return level.clusters; }
+    }
+    return levels.empty() ? empty : levels.back().clusters;
+}
+
+size_t ClusterHierarchy::memoryUsage() const {
+    size_t total = 0;
+    for (auto const& level : levels) {
+        total += sizeof(Level) + level.clusters.capacity() * sizeof(BookmarkCluster);
+    }
+    return total;
+}
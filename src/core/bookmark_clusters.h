@@ -0,0 +1,46 @@
+#pragma once
+#include "overlay_layout.h"
+#include <vector>
+#include <cstdint>
+
+// List colors kept per cluster, the rest of its bookmarks are counted as other
+constexpr int CLUSTER_COLORS = 3;
+
+// Run of consecutive waterfall bookmarks that share a frequency bucket
+struct BookmarkCluster {
+    uint32_t first; // Index of the first bookmark in the sorted waterfall bookmarks
+    uint32_t count;
+    double frequency; // Mean frequency of the bookmarks
+    ImU32 colors[CLUSTER_COLORS]; // Most common list colors, most common first
+    uint32_t colorCounts[CLUSTER_COLORS]; // 0 for unused entries
+};
+
+// Groups the waterfall bookmarks into frequency buckets of 1 Hz, 2 Hz, 4 Hz
+// and so on, one level per octave up to a single bucket for everything. Each
+// level is built by merging the clusters of the level below, and a level that
+// groups exactly like the one below is not stored again.
+//
+// Picking the level whose buckets are at least a given number of pixels wide
+// bounds the clusters in a view by the width of the view, whatever the number
+// of bookmarks.
+class ClusterHierarchy {
+public:
+    // `bookmarks` must be sorted by frequency
+    void build(const BookmarkStore& store, const std::vector<WaterfallBookmark>& bookmarks);
+    void clear();
+
+    // Clusters of the finest level with buckets at least `minWidth` Hz wide, in frequency order
+    const std::vector<BookmarkCluster>& level(double minWidth) const;
+
+    size_t levelCount() const { return levels.size(); }
+    size_t memoryUsage() const;
+
+private:
+    struct Level {
+        double width; // Widest bucket size, in Hz, that still groups like this
+        std::vector<BookmarkCluster> clusters;
+    };
+
+    std::vector<Level> levels;
+    std::vector<int64_t> buckets; // Bucket of each cluster of the level being built
+};
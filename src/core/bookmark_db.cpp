@@ -0,0 +1,353 @@
+#include "bookmark_db.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const char MAGIC[8] = { 'S', 'D', 'R', 'P', 'P', 'B', 'M', 'K' };
+    constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t listCount;
+        uint32_t bookmarkCount;
+        uint64_t heapSize;
+        uint64_t checksum; // Of everything after the header
+        uint64_t journalSequence;
+    };
+
+    struct ListRecord {
+        uint32_t name; // Heap offset
+        uint32_t color;
+        uint8_t shown;
+        uint8_t reserved[7];
+    };
+
+    size_t align8(size_t size) {
+        return (size + 7) & ~(size_t)7;
+    }
+
+    // Offsets of the sections following the header
+    struct Layout {
+        size_t lists, listIds, frequencies, bandwidths, modes, startTimes, endTimes;
+        size_t dayMasks, names, notes, geoinfo, heap, end;
+
+        Layout(size_t listCount, size_t count, size_t heapSize) {
+            size_t pos = 0;
+            auto section = [&pos](size_t size) {
+                size_t start = pos;
+                pos += align8(size);
+                return start;
+            };
+            lists = section(listCount * sizeof(ListRecord));
+            listIds = section(count * sizeof(ListId));
+            frequencies = section(count * sizeof(double));
+            bandwidths = section(count * sizeof(double));
+            modes = section(count * sizeof(uint8_t));
+            startTimes = section(count * sizeof(int16_t));
+            endTimes = section(count * sizeof(int16_t));
+            dayMasks = section(count * sizeof(uint8_t));
+            names = section(count * sizeof(uint32_t));
+            notes = section(count * sizeof(uint32_t));
+            geoinfo = section(count * sizeof(uint32_t));
+            heap = section(heapSize);
+            end = pos;
+        }
+    };
+
+    // FNV-1a over 64 bit words, enough to catch truncated or damaged files
+    uint64_t checksum(const uint8_t* data, size_t size) {
+        uint64_t hash = 14695981039346656037ULL;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            hash ^= word;
+            hash *= 1099511628211ULL;
+        }
+        for (; i < size; i++) {
+            hash ^= data[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    // Read-only mapping of a whole file
+    class MappedFile {
+    public:
+        ~MappedFile() {
+#ifdef _WIN32
+            if (view) { UnmapViewOfFile(view); }
+            if (mapping) { CloseHandle(mapping); }
+            if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); }
+#else
+            if (view) { munmap(view, length); }
+            if (fd >= 0) { close(fd); }
+#endif
+        }
+
+        bool open(const std::string& path) {
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (file == INVALID_HANDLE_VALUE) { return false; }
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(file, &size)) { return false; }
+            length = (size_t)size.QuadPart;
+            if (length == 0) { return true; }
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (!mapping) { return false; }
+            view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            return view != NULL;
+#else
+            fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) { return false; }
+            struct stat st;
+            if (fstat(fd, &st) != 0) { return false; }
+            length = (size_t)st.st_size;
+            if (length == 0) { return true; }
+            void* addr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) { return false; }
+            view = addr;
+            return true;
+#endif
+        }
+
+        const uint8_t* data() const { return (const uint8_t*)view; }
+        size_t size() const { return length; }
+
+    private:
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = NULL;
+#else
+        int fd = -1;
+#endif
+        void* view = NULL;
+        size_t length = 0;
+    };
+
+    template <class T>
+    void readColumn(std::vector<T>& column, const uint8_t* data, size_t count) {
+        column.resize(count);
+        if (count) { memcpy(column.data(), data, count * sizeof(T)); }
+    }
+
+    template <class T>
+    void writeColumn(std::vector<uint8_t>& out, size_t offset, const std::vector<T>& column) {
+        if (!column.empty()) { memcpy(out.data() + offset, column.data(), column.size() * sizeof(T)); }
+    }
+
+    bool syncFile(FILE* file) {
+        if (fflush(file) != 0) { return false; }
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+}
+
+bool BookmarkDatabase::load(BookmarkStore& store, const std::string& path, std::string& error, uint64_t* journalSequence) {
+    MappedFile file;
+    if (!file.open(path)) {
+        error = "Could not open " + path;
+        return false;
+    }
+
+    FileHeader header = {};
+    if (file.size() < sizeof(FileHeader)) {
+        error = "File is truncated";
+        return false;
+    }
+    memcpy(&header, file.data(), sizeof(FileHeader));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC))) {
+        error = "Not a bookmark database";
+        return false;
+    }
+    if (header.byteOrder != BYTE_ORDER_MARK) {
+        error = "Database was written on a machine of a different byte order";
+        return false;
+    }
+    if (header.version != VERSION) {
+        error = "Unsupported database version " + std::to_string(header.version);
+        return false;
+    }
+
+    const uint8_t* body = file.data() + sizeof(FileHeader);
+    size_t bodySize = file.size() - sizeof(FileHeader);
+    if (header.listCount >= INVALID_LIST || header.heapSize == 0 || header.heapSize > UINT32_MAX) {
+        error = "Invalid header";
+        return false;
+    }
+    Layout layout(header.listCount, header.bookmarkCount, header.heapSize);
+    if (bodySize != layout.end) {
+        error = "File size doesn't match its header";
+        return false;
+    }
+    if (checksum(body, bodySize) != header.checksum) {
+        error = "Checksum mismatch, the file is damaged";
+        return false;
+    }
+
+    // Check every reference before touching the store
+    size_t count = header.bookmarkCount;
+    size_t heapSize = header.heapSize;
+    const char* heap = (const char*)body + layout.heap;
+    if (heap[0] != 0 || heap[heapSize - 1] != 0) {
+        error = "Invalid string heap";
+        return false;
+    }
+    std::vector<ListRecord> lists(header.listCount);
+    if (!lists.empty()) { memcpy(lists.data(), body + layout.lists, lists.size() * sizeof(ListRecord)); }
+    for (auto const& list : lists) {
+        if (list.name >= heapSize) {
+            error = "Invalid list record";
+            return false;
+        }
+    }
+
+    BookmarkStore loaded;
+    readColumn(loaded.listIds.edit(), body + layout.listIds, count);
+    readColumn(loaded.frequencies.edit(), body + layout.frequencies, count);
+    readColumn(loaded.bandwidths.edit(), body + layout.bandwidths, count);
+    readColumn(loaded.modes.edit(), body + layout.modes, count);
+    readColumn(loaded.startTimes.edit(), body + layout.startTimes, count);
+    readColumn(loaded.endTimes.edit(), body + layout.endTimes, count);
+    readColumn(loaded.dayMasks.edit(), body + layout.dayMasks, count);
+    readColumn(loaded.names.edit(), body + layout.names, count);
+    readColumn(loaded.notesOffsets.edit(), body + layout.notes, count);
+    readColumn(loaded.geoinfoOffsets.edit(), body + layout.geoinfo, count);
+    for (size_t i = 0; i < count; i++) {
+        if (loaded.listIds[i] >= lists.size() || loaded.names[i] >= heapSize
+            || loaded.notesOffsets[i] >= heapSize || loaded.geoinfoOffsets[i] >= heapSize) {
+            error = "Invalid bookmark record";
+            return false;
+        }
+    }
+
+    loaded.strings.edit().assign(heap, heapSize);
+    for (auto const& list : lists) {
+        loaded.lists.edit().push_back({ heap + list.name, list.color, list.shown != 0, true });
+    }
+    loaded.count = count;
+    loaded.nameRehash(std::max<size_t>(64, count * 2));
+
+    loaded.epoch = store.epoch + 1;
+    store = std::move(loaded);
+    if (journalSequence) { *journalSequence = header.journalSequence; }
+    return true;
+}
+
+bool BookmarkDatabase::save(const BookmarkStore& store, const std::string& path, std::string& error, uint64_t journalSequence) {
+    // Only lists still alive are written, renumbered densely
+    std::vector<ListId> listMap(store.lists.size(), INVALID_LIST);
+    std::vector<ListRecord> lists;
+    StringHeap heap;
+    for (size_t i = 0; i < store.lists.size(); i++) {
+        const BookmarkList& list = store.lists[i];
+        if (!list.alive) { continue; }
+        listMap[i] = lists.size();
+        ListRecord record = {};
+        record.name = heap.add(list.name);
+        record.color = list.color;
+        record.shown = list.shown;
+        lists.push_back(record);
+    }
+
+    // Bookmarks in frequency order, without the holes left by removed ids
+    std::vector<BookmarkId> order;
+    order.reserve(store.size());
+    for (BookmarkId id = 0; id < store.listIds.size(); id++) {
+        if (store.valid(id)) { order.push_back(id); }
+    }
+    std::stable_sort(order.begin(), order.end(), [&store](BookmarkId a, BookmarkId b) {
+        return store.frequencies[a] < store.frequencies[b];
+    });
+
+    size_t count = order.size();
+    std::vector<ListId> listIds(count);
+    std::vector<double> frequencies(count), bandwidths(count);
+    std::vector<uint8_t> modes(count), dayMasks(count);
+    std::vector<int16_t> startTimes(count), endTimes(count);
+    std::vector<uint32_t> names(count), notes(count), geoinfo(count);
+    for (size_t i = 0; i < count; i++) {
+        BookmarkId id = order[i];
+        listIds[i] = listMap[store.listIds[id]];
+        frequencies[i] = store.frequencies[id];
+        bandwidths[i] = store.bandwidths[id];
+        modes[i] = store.modes[id];
+        startTimes[i] = store.startTimes[id];
+        endTimes[i] = store.endTimes[id];
+        dayMasks[i] = store.dayMasks[id];
+        names[i] = heap.add(store.name(id));
+        notes[i] = heap.add(store.notes(id));
+        geoinfo[i] = heap.add(store.geoinfo(id));
+    }
+    if (heap.size() > UINT32_MAX) {
+        error = "Too much text to store";
+        return false;
+    }
+
+    Layout layout(lists.size(), count, heap.size());
+    std::vector<uint8_t> body(layout.end, 0);
+    writeColumn(body, layout.lists, lists);
+    writeColumn(body, layout.listIds, listIds);
+    writeColumn(body, layout.frequencies, frequencies);
+    writeColumn(body, layout.bandwidths, bandwidths);
+    writeColumn(body, layout.modes, modes);
+    writeColumn(body, layout.startTimes, startTimes);
+    writeColumn(body, layout.endTimes, endTimes);
+    writeColumn(body, layout.dayMasks, dayMasks);
+    writeColumn(body, layout.names, names);
+    writeColumn(body, layout.notes, notes);
+    writeColumn(body, layout.geoinfo, geoinfo);
+    memcpy(body.data() + layout.heap, heap.raw(), heap.size());
+
+    FileHeader header = {};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.listCount = lists.size();
+    header.bookmarkCount = count;
+    header.heapSize = heap.size();
+    header.checksum = checksum(body.data(), body.size());
+    header.journalSequence = journalSequence;
+
+    std::string tmpPath = path + ".tmp";
+    FILE* file = fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        error = "Could not create " + tmpPath;
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(body.data(), 1, body.size(), file) == body.size();
+    ok = syncFile(file) && ok;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok) {
+        error = "Could not write " + tmpPath;
+        std::filesystem::remove(tmpPath);
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        error = "Could not replace " + path + ": " + ec.message();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "bookmark_store.h"
+#include <string>
+
+// Binary file holding every list and bookmark of a BookmarkStore.
+//
+// The file mirrors the store's columns: a header, the list table, then one
+// array per field and the string heap, each section aligned to 8 bytes. Loading
+// maps the file and copies every column in one go instead of parsing records.
+// Bookmarks are written in frequency order, so the waterfall order of a freshly
+// loaded store is already sorted.
+//
+// Every field is stored in the byte order of the machine writing the file; a
+// file from a machine of the other byte order is rejected.
+class BookmarkDatabase {
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    // Replaces the content of the store with the file's. On failure the store
+    // is left untouched and the reason is put in `error`. `journalSequence`
+    // receives the last edit journal record included in the file.
+    static bool load(BookmarkStore& store, const std::string& path, std::string& error, uint64_t* journalSequence = nullptr);
+
+    // Writes the store to a temporary file and renames it over `path`, so the
+    // previous file stays intact if writing fails
+    static bool save(const BookmarkStore& store, const std::string& path, std::string& error, uint64_t journalSequence = 0);
+};
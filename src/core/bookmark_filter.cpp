@@ -0,0 +1,152 @@
+#include "bookmark_filter.h"
+#include "text_fold.h"
+#include <algorithm>
+#include <cmath>
+
+bool OverlayFilter::active() const {
+    return onlineOnly || modes != 0 || !lists.empty() || minBandwidth > 0.0 || maxBandwidth > 0.0 || !name.empty();
+}
+
+bool OverlayFilter::operator==(const OverlayFilter& other) const {
+    return onlineOnly == other.onlineOnly && modes == other.modes && lists == other.lists &&
+           minBandwidth == other.minBandwidth && maxBandwidth == other.maxBandwidth && name == other.name;
+}
+
+void BookmarkFilter::build(const BookmarkStore& store, const std::vector<WaterfallBookmark>& bookmarks) {
+    clear();
+    count = bookmarks.size();
+    words = (count + 63) / 64;
+
+    bandwidths.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        BookmarkId id = bookmarks[i].id;
+        int mode = store.mode(id);
+        ListId list = store.listOf(id);
+        if ((size_t)mode >= modeBits.size()) { modeBits.resize(mode + 1); }
+        if ((size_t)list >= listBits.size()) { listBits.resize(list + 1); }
+        if (modeBits[mode].empty()) { modeBits[mode].assign(words, 0); }
+        if (listBits[list].empty()) { listBits[list].assign(words, 0); }
+        modeBits[mode][i / 64] |= (uint64_t)1 << (i % 64);
+        listBits[list][i / 64] |= (uint64_t)1 << (i % 64);
+        bandwidths[i] = store.bandwidth(id);
+    }
+}
+
+void BookmarkFilter::clear() {
+    count = 0;
+    words = 0;
+    modeBits.clear();
+    listBits.clear();
+    bandwidths.clear();
+    bandwidthValid = false;
+    nameValid = false;
+    onlineValid = false;
+    resultValid = false;
+    passed.clear();
+    passedIndex.clear();
+}
+
+bool BookmarkFilter::apply(const BookmarkStore& store, const ScheduleEngine& schedule, const std::vector<WaterfallBookmark>& bookmarks,
+                           const OverlayFilter& filter) {
+    if (resultValid && filter == applied && (!filter.onlineOnly || schedule.generation() == appliedGeneration)) { return false; }
+
+    fill(result, ~(uint64_t)0);
+
+    if (filter.modes != 0) {
+        fill(scratch, 0);
+        for (size_t mode = 0; mode < modeBits.size() && mode < 32; mode++) {
+            if ((filter.modes & (1u << mode)) && !modeBits[mode].empty()) { orInto(scratch, modeBits[mode]); }
+        }
+        andInto(result, scratch);
+    }
+
+    if (!filter.lists.empty()) {
+        fill(scratch, 0);
+        for (ListId list : filter.lists) {
+            if (list < listBits.size() && !listBits[list].empty()) { orInto(scratch, listBits[list]); }
+        }
+        andInto(result, scratch);
+    }
+
+    if (filter.minBandwidth > 0.0 || filter.maxBandwidth > 0.0) {
+        if (!bandwidthValid || filter.minBandwidth != bandwidthMin || filter.maxBandwidth != bandwidthMax) {
+            fill(bandwidthBits, 0);
+            double maxBandwidth = (filter.maxBandwidth > 0.0) ? filter.maxBandwidth : INFINITY;
+            for (size_t i = 0; i < count; i++) {
+                bool inRange = bandwidths[i] >= filter.minBandwidth && bandwidths[i] <= maxBandwidth;
+                bandwidthBits[i / 64] |= (uint64_t)inRange << (i % 64);
+            }
+            bandwidthMin = filter.minBandwidth;
+            bandwidthMax = filter.maxBandwidth;
+            bandwidthValid = true;
+        }
+        andInto(result, bandwidthBits);
+    }
+
+    if (!filter.name.empty()) {
+        std::string folded = foldText(filter.name);
+        if (!nameValid || folded != nameFolded) {
+            fill(nameBits, 0);
+            for (size_t i = 0; i < count; i++) {
+                bool matches = containsFolded(store.name(bookmarks[i].id), folded);
+                nameBits[i / 64] |= (uint64_t)matches << (i % 64);
+            }
+            nameFolded = std::move(folded);
+            nameValid = true;
+        }
+        andInto(result, nameBits);
+    }
+
+    if (filter.onlineOnly) {
+        if (!onlineValid || schedule.generation() != onlineGeneration) {
+            fill(onlineBits, 0);
+            for (size_t i = 0; i < count; i++) {
+                onlineBits[i / 64] |= (uint64_t)schedule.online(bookmarks[i].id) << (i % 64);
+            }
+            onlineGeneration = schedule.generation();
+            onlineValid = true;
+        }
+        andInto(result, onlineBits);
+    }
+
+    // Gather what passed, skipping whole words of filtered out bookmarks
+    passed.clear();
+    passedIndex.clear();
+    for (size_t w = 0; w < words; w++) {
+        uint64_t word = result[w];
+        for (size_t i = w * 64; word != 0; i++, word >>= 1) {
+            if (!(word & 1)) { continue; }
+            passed.push_back(bookmarks[i]);
+            passedIndex.push(store.frequency(bookmarks[i].id));
+        }
+    }
+
+    applied = filter;
+    appliedGeneration = schedule.generation();
+    resultValid = true;
+    return true;
+}
+
+void BookmarkFilter::fill(Bits& bits, uint64_t word) const {
+    bits.assign(words, word);
+    // Bits past the last bookmark stay clear, so they never pass
+    if (count % 64 != 0 && words > 0) {
+        bits[words - 1] &= ((uint64_t)1 << (count % 64)) - 1;
+    }
+}
+
+void BookmarkFilter::orInto(Bits& dst, const Bits& src) {
+    for (size_t i = 0; i < dst.size(); i++) { dst[i] |= src[i]; }
+}
+
+void BookmarkFilter::andInto(Bits& dst, const Bits& src) {
+    for (size_t i = 0; i < dst.size(); i++) { dst[i] &= src[i]; }
+}
+
+size_t BookmarkFilter::memoryUsage() const {
+    size_t total = (bandwidths.capacity() * sizeof(double)) + passed.capacity() * sizeof(WaterfallBookmark);
+    for (auto const& bits : modeBits) { total += bits.capacity() * sizeof(uint64_t); }
+    for (auto const& bits : listBits) { total += bits.capacity() * sizeof(uint64_t); }
+    total += (bandwidthBits.capacity() + nameBits.capacity() + onlineBits.capacity() + result.capacity() + scratch.capacity()) * sizeof(uint64_t);
+    return total;
+}
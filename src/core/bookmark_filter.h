@@ -0,0 +1,81 @@
+#pragma once
+#include "overlay_layout.h"
+#include "frequency_index.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Which of the waterfall bookmarks the overlay shows. Parts left at their
+// defaults let every bookmark through.
+struct OverlayFilter {
+    bool onlineOnly = false;
+    uint32_t modes = 0; // Bit per mode to keep, 0 for any
+    std::vector<ListId> lists; // Lists to keep, empty for any
+    double minBandwidth = 0.0;
+    double maxBandwidth = 0.0; // 0 for no upper bound
+    std::string name; // Matched case-insensitively anywhere in the name
+
+    bool active() const;
+    bool operator==(const OverlayFilter& other) const;
+    bool operator!=(const OverlayFilter& other) const { return !(*this == other); }
+};
+
+// Filters the waterfall bookmarks before they are laid out, with a bit per
+// bookmark for each part of the filter.
+//
+// The bits of each mode and each list are set once per change of the
+// bookmarks. Those of the bandwidth range, the name and the on air states are
+// set when that part of the filter, or the states, change. Applying a filter
+// is then a few ORs and ANDs over the bits, and its result is kept until the
+// bookmarks, the filter or the on air states change.
+class BookmarkFilter {
+public:
+    // `bookmarks` must be sorted by frequency, and given again to apply()
+    void build(const BookmarkStore& store, const std::vector<WaterfallBookmark>& bookmarks);
+    void clear();
+
+    // Returns true if the bookmarks that passed changed
+    bool apply(const BookmarkStore& store, const ScheduleEngine& schedule, const std::vector<WaterfallBookmark>& bookmarks,
+               const OverlayFilter& filter);
+
+    // The bookmarks that passed in frequency order, and their index, ready
+    // for the layout
+    const std::vector<WaterfallBookmark>& bookmarks() const { return passed; }
+    const FrequencyIndex& index() const { return passedIndex; }
+
+    size_t memoryUsage() const;
+
+private:
+    typedef std::vector<uint64_t> Bits;
+
+    void fill(Bits& bits, uint64_t word) const;
+    static void orInto(Bits& dst, const Bits& src);
+    static void andInto(Bits& dst, const Bits& src);
+
+    size_t count = 0; // Bookmarks given to build()
+    size_t words = 0;
+    std::vector<Bits> modeBits; // Indexed by mode, empty for modes no bookmark has
+    std::vector<Bits> listBits; // Indexed by list, empty for lists no bookmark is in
+    std::vector<double> bandwidths; // In bookmark order
+
+    // Bits of the last bandwidth range, name and on air states asked for
+    Bits bandwidthBits;
+    double bandwidthMin = 0.0;
+    double bandwidthMax = 0.0;
+    Bits nameBits;
+    std::string nameFolded;
+    Bits onlineBits;
+    uint64_t onlineGeneration = 0;
+    bool bandwidthValid = false;
+    bool nameValid = false;
+    bool onlineValid = false;
+
+    Bits result;
+    Bits scratch;
+    OverlayFilter applied;
+    uint64_t appliedGeneration = 0;
+    bool resultValid = false;
+
+    std::vector<WaterfallBookmark> passed;
+    FrequencyIndex passedIndex;
+};
@@ -0,0 +1,260 @@
+#include "bookmark_import.h"
+#include <algorithm>
+#include <cstdio>
+#include <istream>
+#include <streambuf>
+
+namespace {
+    // Reads the file in large blocks, counting the bytes for the progress bar
+    // and ending the stream early when the import is cancelled
+    class ImportStreamBuf : public std::streambuf {
+    public:
+        ImportStreamBuf(FILE* file, std::atomic<uint64_t>& bytesRead, const std::atomic<bool>& cancelled) :
+            file(file), bytesRead(bytesRead), cancelled(cancelled) {}
+
+    protected:
+        int_type underflow() override {
+            if (gptr() < egptr()) { return traits_type::to_int_type(*gptr()); }
+            if (cancelled.load(std::memory_order_relaxed)) { return traits_type::eof(); }
+            size_t count = fread(buffer, 1, sizeof(buffer), file);
+            if (count == 0) { return traits_type::eof(); }
+            bytesRead.fetch_add(count, std::memory_order_relaxed);
+            setg(buffer, buffer, buffer + count);
+            return traits_type::to_int_type(*gptr());
+        }
+
+    private:
+        FILE* file;
+        std::atomic<uint64_t>& bytesRead;
+        const std::atomic<bool>& cancelled;
+        char buffer[1 << 16];
+    };
+
+    // Picks the entries of the top level "bookmarks" object out of the event
+    // stream. Each entry is rebuilt as a small JSON value and converted with
+    // bookmarkFromJson, so the accepted format stays the same as the config's.
+    class ImportHandler : public nlohmann::json_sax<json> {
+    public:
+        ImportHandler(BookmarkImporter::Entries& entries, size_t& skipped, std::atomic<size_t>& parsedCount, const std::atomic<bool>& cancelled) :
+            entries(entries), skipped(skipped), parsedCount(parsedCount), cancelled(cancelled) {}
+
+        bool null() override { return value(nullptr); }
+        bool boolean(bool val) override { return value(val); }
+        bool number_integer(number_integer_t val) override { return value(val); }
+        bool number_unsigned(number_unsigned_t val) override { return value(val); }
+        bool number_float(number_float_t val, const string_t&) override { return value(val); }
+        bool string(string_t& val) override { return value(std::move(val)); }
+        bool binary(binary_t& val) override { return value(json::binary(std::move(val))); }
+
+        bool start_object(std::size_t) override { return open(json::object()); }
+        bool end_object() override { return close(); }
+        bool start_array(std::size_t) override { return open(json::array()); }
+        bool end_array() override { return close(); }
+
+        bool key(string_t& val) override {
+            if (!stack.empty()) {
+                entryKey = std::move(val);
+            }
+            else if (depth == 1) {
+                bookmarksNext = (val == "bookmarks");
+            }
+            else if (inBookmarks && depth == 2) {
+                entryName = std::move(val);
+            }
+            return !cancelled.load(std::memory_order_relaxed);
+        }
+
+        bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) override {
+            error = ex.what();
+            return false;
+        }
+
+        bool found = false;
+        bool invalid = false;
+        std::string error;
+
+    private:
+        // Whether the next value is a bookmark or part of one
+        bool inEntry() const { return !stack.empty() || (inBookmarks && depth == 2); }
+
+        json* put(json&& val) {
+            if (stack.empty()) {
+                entry = std::move(val);
+                return &entry;
+            }
+            json& parent = *stack.back();
+            if (parent.is_array()) {
+                parent.push_back(std::move(val));
+                return &parent.back();
+            }
+            json& slot = parent[entryKey];
+            slot = std::move(val);
+            return &slot;
+        }
+
+        bool value(json&& val) {
+            if (inEntry()) {
+                put(std::move(val));
+                if (stack.empty()) { finishEntry(); }
+            }
+            else if (depth == 1 && bookmarksNext) {
+                invalid = true;
+                bookmarksNext = false;
+            }
+            return !cancelled.load(std::memory_order_relaxed);
+        }
+
+        bool open(json&& container) {
+            if (inEntry()) {
+                stack.push_back(put(std::move(container)));
+            }
+            else {
+                depth++;
+                if (depth == 2 && bookmarksNext) {
+                    if (container.is_object()) {
+                        inBookmarks = true;
+                        found = true;
+                    }
+                    else {
+                        invalid = true;
+                    }
+                }
+                bookmarksNext = false;
+            }
+            return !cancelled.load(std::memory_order_relaxed);
+        }
+
+        bool close() {
+            if (!stack.empty()) {
+                stack.pop_back();
+                if (stack.empty()) { finishEntry(); }
+            }
+            else {
+                if (depth == 2) { inBookmarks = false; }
+                depth--;
+            }
+            return !cancelled.load(std::memory_order_relaxed);
+        }
+
+        void finishEntry() {
+            // bookmarkFromJson expects the required fields to be there
+            if (!entry.is_object() || !entry.contains("frequency") || !entry.contains("bandwidth") || !entry.contains("mode")) {
+                skipped++;
+                entry = nullptr;
+                return;
+            }
+            try {
+                entries.push_back({ std::move(entryName), bookmarkFromJson(entry) });
+                parsedCount.fetch_add(1, std::memory_order_relaxed);
+            }
+            catch (const std::exception&) {
+                // Wrong types, or days and mode out of range
+                skipped++;
+            }
+            entry = nullptr;
+        }
+
+        BookmarkImporter::Entries& entries;
+        size_t& skipped;
+        std::atomic<size_t>& parsedCount;
+        const std::atomic<bool>& cancelled;
+
+        int depth = 0;
+        bool bookmarksNext = false;
+        bool inBookmarks = false;
+
+        std::string entryName;
+        std::string entryKey;
+        json entry;
+        std::vector<json*> stack;
+    };
+}
+
+BookmarkImporter::~BookmarkImporter() {
+    cancel();
+    join();
+}
+
+bool BookmarkImporter::start(const std::string& path) {
+    if (running()) { return false; }
+    join();
+
+    entries.clear();
+    skipped = 0;
+    error.clear();
+    cancelled = false;
+    bytesRead = 0;
+    fileSize = 0;
+    parsedCount = 0;
+    _state.store(IMPORT_RUNNING, std::memory_order_release);
+    workerThread = std::thread(&BookmarkImporter::worker, this, path);
+    return true;
+}
+
+void BookmarkImporter::cancel() {
+    cancelled = true;
+}
+
+float BookmarkImporter::progress() const {
+    uint64_t size = fileSize.load(std::memory_order_relaxed);
+    if (size == 0) { return 0.0f; }
+    return std::min<float>((float)bytesRead.load(std::memory_order_relaxed) / (float)size, 1.0f);
+}
+
+bool BookmarkImporter::collect(State& result, Entries& entries, size_t& skipped, std::string& error) {
+    State s = state();
+    if (s == IMPORT_IDLE || s == IMPORT_RUNNING) { return false; }
+    join();
+
+    result = s;
+    entries = std::move(this->entries);
+    this->entries.clear();
+    skipped = this->skipped;
+    error = std::move(this->error);
+    _state.store(IMPORT_IDLE, std::memory_order_release);
+    return true;
+}
+
+void BookmarkImporter::join() {
+    if (workerThread.joinable()) { workerThread.join(); }
+}
+
+void BookmarkImporter::worker(std::string path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        error = "Could not open " + path;
+        _state.store(IMPORT_FAILED, std::memory_order_release);
+        return;
+    }
+    if (fseek(file, 0, SEEK_END) == 0) {
+        long size = ftell(file);
+        if (size > 0) { fileSize = (uint64_t)size; }
+        fseek(file, 0, SEEK_SET);
+    }
+
+    ImportStreamBuf buf(file, bytesRead, cancelled);
+    std::istream stream(&buf);
+    ImportHandler handler(entries, skipped, parsedCount, cancelled);
+    bool ok = json::sax_parse(stream, &handler);
+    fclose(file);
+
+    State result = IMPORT_DONE;
+    if (cancelled) {
+        entries.clear();
+        result = IMPORT_CANCELLED;
+    }
+    else if (!ok) {
+        error = handler.error.empty() ? "Could not parse the file" : handler.error;
+        result = IMPORT_FAILED;
+    }
+    else if (handler.invalid) {
+        error = "Bookmark attribute is invalid";
+        result = IMPORT_FAILED;
+    }
+    else if (!handler.found) {
+        error = "File does not contains any bookmarks";
+        result = IMPORT_FAILED;
+    }
+    if (result == IMPORT_FAILED) { entries.clear(); }
+    _state.store(result, std::memory_order_release);
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "bookmark.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Reads a bookmark file on a worker thread. The file is streamed through a
+// SAX parser, so only one bookmark is held as JSON at any time, and the
+// converted bookmarks are handed to the UI thread in one go once done.
+class BookmarkImporter {
+public:
+    enum State {
+        IMPORT_IDLE,
+        IMPORT_RUNNING,
+        IMPORT_DONE,
+        IMPORT_FAILED,
+        IMPORT_CANCELLED
+    };
+
+    typedef std::vector<std::pair<std::string, FrequencyBookmark>> Entries;
+
+    ~BookmarkImporter();
+
+    // Starts reading the file. Returns false if an import is still in progress.
+    bool start(const std::string& path);
+
+    // Asks the worker to stop, the import then finishes as cancelled
+    void cancel();
+
+    State state() const { return _state.load(std::memory_order_acquire); }
+    bool running() const { return state() == IMPORT_RUNNING; }
+
+    // Fraction of the file read so far
+    float progress() const;
+
+    // Number of bookmarks parsed so far
+    size_t parsed() const { return parsedCount.load(std::memory_order_relaxed); }
+
+    // Once the worker is done, hands over the bookmarks in file order, the
+    // number of entries that couldn't be converted and the error message if
+    // any, then goes back to idle. Returns false while running or idle.
+    bool collect(State& result, Entries& entries, size_t& skipped, std::string& error);
+
+private:
+    void worker(std::string path);
+    void join();
+
+    std::thread workerThread;
+    std::atomic<State> _state { IMPORT_IDLE };
+    std::atomic<bool> cancelled { false };
+    std::atomic<uint64_t> bytesRead { 0 };
+    std::atomic<uint64_t> fileSize { 0 };
+    std::atomic<size_t> parsedCount { 0 };
+
+    // Only touched by the worker until it publishes its final state
+    Entries entries;
+    size_t skipped = 0;
+    std::string error;
+};
@@ -0,0 +1,395 @@
+#include "bookmark_journal.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    const char MAGIC[8] = { 'S', 'D', 'R', 'P', 'P', 'J', 'N', 'L' };
+    constexpr uint32_t VERSION = 1;
+    constexpr size_t HEADER_SIZE = sizeof(MAGIC) + sizeof(uint32_t);
+
+    // Record layout: u32 payload size, payload (u64 sequence, u8 op, fields), u32 checksum of the payload
+    constexpr size_t RECORD_OVERHEAD = 2 * sizeof(uint32_t);
+    constexpr uint32_t MAX_RECORD_SIZE = 1 << 24;
+
+    uint32_t checksum(const uint8_t* data, size_t size) {
+        // FNV-1a
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= data[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    bool syncFile(FILE* file) {
+        if (fflush(file) != 0) { return false; }
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fdatasync(fileno(file)) == 0;
+#endif
+    }
+
+    // Bounds checked reading of a record payload
+    class Reader {
+    public:
+        Reader(const uint8_t* data, size_t size) : pos(data), end(data + size) {}
+
+        bool u8(uint8_t& val) { return take(&val, 1); }
+        bool u32(uint32_t& val) { return take(&val, 4); }
+        bool u64(uint64_t& val) { return take(&val, 8); }
+        bool f64(double& val) { return take(&val, 8); }
+
+        bool str(std::string& val) {
+            uint32_t len;
+            if (!u32(len) || (size_t)(end - pos) < len) { return false; }
+            val.assign((const char*)pos, len);
+            pos += len;
+            return true;
+        }
+
+        bool bookmark(FrequencyBookmark& bm) {
+            uint32_t mode, startTime, endTime;
+            uint8_t days;
+            if (!f64(bm.frequency) || !f64(bm.bandwidth) || !u32(mode) || !u32(startTime) || !u32(endTime) || !u8(days)) { return false; }
+            bm.mode = (int)mode;
+            bm.startTime = (int)startTime;
+            bm.endTime = (int)endTime;
+            maskToDays(days, bm.days);
+            return str(bm.notes) && str(bm.geoinfo);
+        }
+
+    private:
+        bool take(void* val, size_t size) {
+            if ((size_t)(end - pos) < size) { return false; }
+            memcpy(val, pos, size);
+            pos += size;
+            return true;
+        }
+
+        const uint8_t* pos;
+        const uint8_t* end;
+    };
+}
+
+EditJournal::~EditJournal() {
+    close();
+}
+
+bool EditJournal::open(const std::string& path, BookmarkStore& store, uint64_t dbSequence, size_t& replayed, std::string& error) {
+    close();
+    this->path = path;
+    seq = dbSequence;
+    replayed = 0;
+    pending.clear();
+
+    // Read whatever is there, then start over from the last good record
+    std::vector<uint8_t> data;
+    if (FILE* in = fopen(path.c_str(), "rb")) {
+        uint8_t chunk[1 << 16];
+        size_t count;
+        while ((count = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+            data.insert(data.end(), chunk, chunk + count);
+        }
+        fclose(in);
+    }
+
+    size_t good = HEADER_SIZE;
+    bool valid = data.size() >= HEADER_SIZE && !memcmp(data.data(), MAGIC, sizeof(MAGIC));
+    if (valid) {
+        uint32_t version;
+        memcpy(&version, data.data() + sizeof(MAGIC), sizeof(version));
+        valid = (version == VERSION);
+    }
+    if (valid) {
+        size_t pos = HEADER_SIZE;
+        while (data.size() - pos >= RECORD_OVERHEAD) {
+            uint32_t size, sum;
+            memcpy(&size, data.data() + pos, sizeof(size));
+            if (size < 9 || size > MAX_RECORD_SIZE || data.size() - pos - RECORD_OVERHEAD < size) { break; }
+            const uint8_t* payload = data.data() + pos + sizeof(uint32_t);
+            memcpy(&sum, payload + size, sizeof(sum));
+            if (sum != checksum(payload, size)) { break; }
+
+            uint64_t recordSeq;
+            memcpy(&recordSeq, payload, sizeof(recordSeq));
+            if (recordSeq > dbSequence) {
+                apply(store, payload + sizeof(uint64_t), size - sizeof(uint64_t));
+                replayed++;
+            }
+            seq = std::max<uint64_t>(seq, recordSeq);
+            pos += size + RECORD_OVERHEAD;
+            good = pos;
+        }
+    }
+
+    if (valid) {
+        // Cut off a damaged or incomplete tail
+        if (good != data.size()) {
+            std::error_code ec;
+            std::filesystem::resize_file(path, good, ec);
+            if (ec) {
+                error = "Could not truncate " + path + ": " + ec.message();
+                return false;
+            }
+        }
+        file = fopen(path.c_str(), "ab");
+        fileSize = good;
+    }
+    else {
+        // Keep a journal that can't be read, its edits may still be
+        // recovered by hand
+        if (!data.empty()) {
+            std::error_code ec;
+            std::filesystem::rename(path, path + ".bad", ec);
+            if (ec) {
+                error = "Could not move aside " + path + ": " + ec.message();
+                return false;
+            }
+            error = "Unreadable journal moved to " + path + ".bad";
+        }
+        file = fopen(path.c_str(), "wb");
+        if (file && !writeHeader(file)) {
+            fclose(file);
+            file = NULL;
+        }
+        fileSize = HEADER_SIZE;
+    }
+    if (!file) {
+        error = "Could not open " + path;
+        return false;
+    }
+    return true;
+}
+
+void EditJournal::close() {
+    if (!file) { return; }
+    fclose(file);
+    file = NULL;
+}
+
+bool EditJournal::writeHeader(FILE* f) {
+    uint32_t version = VERSION;
+    return fwrite(MAGIC, sizeof(MAGIC), 1, f) == 1 && fwrite(&version, sizeof(version), 1, f) == 1 && syncFile(f);
+}
+
+void EditJournal::addList(std::string_view list, uint32_t color, bool shown) {
+    size_t start = beginRecord(OP_ADD_LIST);
+    putString(list);
+    putU32(color);
+    putU8(shown);
+    endRecord(start);
+}
+
+void EditJournal::removeList(std::string_view list) {
+    size_t start = beginRecord(OP_REMOVE_LIST);
+    putString(list);
+    endRecord(start);
+}
+
+void EditJournal::renameList(std::string_view list, std::string_view newName) {
+    size_t start = beginRecord(OP_RENAME_LIST);
+    putString(list);
+    putString(newName);
+    endRecord(start);
+}
+
+void EditJournal::setListColor(std::string_view list, uint32_t color) {
+    size_t start = beginRecord(OP_SET_LIST_COLOR);
+    putString(list);
+    putU32(color);
+    endRecord(start);
+}
+
+void EditJournal::setListShown(std::string_view list, bool shown) {
+    size_t start = beginRecord(OP_SET_LIST_SHOWN);
+    putString(list);
+    putU8(shown);
+    endRecord(start);
+}
+
+void EditJournal::addBookmark(std::string_view list, std::string_view name, const FrequencyBookmark& bm) {
+    size_t start = beginRecord(OP_ADD_BOOKMARK);
+    putString(list);
+    putString(name);
+    putBookmark(bm);
+    endRecord(start);
+}
+
+void EditJournal::updateBookmark(std::string_view list, std::string_view name, std::string_view newName, const FrequencyBookmark& bm) {
+    size_t start = beginRecord(OP_UPDATE_BOOKMARK);
+    putString(list);
+    putString(name);
+    putString(newName);
+    putBookmark(bm);
+    endRecord(start);
+}
+
+void EditJournal::removeBookmark(std::string_view list, std::string_view name) {
+    size_t start = beginRecord(OP_REMOVE_BOOKMARK);
+    putString(list);
+    putString(name);
+    endRecord(start);
+}
+
+std::vector<uint8_t> EditJournal::takePending() {
+    std::vector<uint8_t> records;
+    records.swap(pending);
+    return records;
+}
+
+bool EditJournal::write(const std::vector<uint8_t>& records) {
+    if (!file) { return false; }
+    if (records.empty()) { return true; }
+    size_t written = fwrite(records.data(), 1, records.size(), file);
+    bool ok = syncFile(file) && written == records.size();
+    fileSize += written;
+    return ok;
+}
+
+bool EditJournal::truncate(std::string& error) {
+    if (!file) { return false; }
+
+    // Swap in a fresh journal, so a crash leaves either the old or the empty one
+    std::string tmpPath = path + ".tmp";
+    FILE* out = fopen(tmpPath.c_str(), "wb");
+    if (!out) {
+        error = "Could not create " + tmpPath;
+        return false;
+    }
+    bool ok = writeHeader(out);
+    ok = (fclose(out) == 0) && ok;
+    if (!ok) {
+        error = "Could not write " + tmpPath;
+        return false;
+    }
+
+    fclose(file);
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        error = "Could not replace " + path + ": " + ec.message();
+    }
+    else {
+        fileSize = HEADER_SIZE;
+    }
+    file = fopen(path.c_str(), "ab");
+    return !ec && file;
+}
+
+size_t EditJournal::beginRecord(Op op) {
+    size_t start = pending.size();
+    putU32(0); // Size, filled in by endRecord()
+    putU64(++seq);
+    putU8(op);
+    return start;
+}
+
+void EditJournal::endRecord(size_t start) {
+    uint32_t size = pending.size() - start - sizeof(uint32_t);
+    memcpy(pending.data() + start, &size, sizeof(size));
+    putU32(checksum(pending.data() + start + sizeof(uint32_t), size));
+}
+
+void EditJournal::putU8(uint8_t val) {
+    pending.push_back(val);
+}
+
+void EditJournal::putU32(uint32_t val) {
+    uint8_t bytes[4];
+    memcpy(bytes, &val, 4);
+    pending.insert(pending.end(), bytes, bytes + 4);
+}
+
+void EditJournal::putU64(uint64_t val) {
+    uint8_t bytes[8];
+    memcpy(bytes, &val, 8);
+    pending.insert(pending.end(), bytes, bytes + 8);
+}
+
+void EditJournal::putDouble(double val) {
+    uint8_t bytes[8];
+    memcpy(bytes, &val, 8);
+    pending.insert(pending.end(), bytes, bytes + 8);
+}
+
+void EditJournal::putString(std::string_view str) {
+    putU32(str.size());
+    pending.insert(pending.end(), str.begin(), str.end());
+}
+
+void EditJournal::putBookmark(const FrequencyBookmark& bm) {
+    putDouble(bm.frequency);
+    putDouble(bm.bandwidth);
+    putU32(bm.mode);
+    putU32(bm.startTime);
+    putU32(bm.endTime);
+    putU8(daysToMask(bm.days));
+    putString(bm.notes);
+    putString(bm.geoinfo);
+}
+
+bool EditJournal::apply(BookmarkStore& store, const uint8_t* data, size_t size) {
+    // Replaying has to cope with edits the store already has, so adds of an
+    // existing name update it and edits of missing entries are ignored
+    Reader in(data, size);
+    uint8_t op;
+    std::string list, name, newName;
+    uint32_t color;
+    uint8_t shown;
+    FrequencyBookmark bm;
+    if (!in.u8(op) || !in.str(list)) { return false; }
+    ListId id = store.findList(list);
+
+    switch (op) {
+    case OP_ADD_LIST:
+        if (!in.u32(color) || !in.u8(shown)) { return false; }
+        if (id == INVALID_LIST) { store.addList(list, color, shown); }
+        return true;
+    case OP_REMOVE_LIST:
+        if (id != INVALID_LIST) { store.removeList(id); }
+        return true;
+    case OP_RENAME_LIST:
+        if (!in.str(newName)) { return false; }
+        if (id != INVALID_LIST && store.findList(newName) == INVALID_LIST) { store.renameList(id, newName); }
+        return true;
+    case OP_SET_LIST_COLOR:
+        if (!in.u32(color)) { return false; }
+        if (id != INVALID_LIST) { store.setListColor(id, color); }
+        return true;
+    case OP_SET_LIST_SHOWN:
+        if (!in.u8(shown)) { return false; }
+        if (id != INVALID_LIST) { store.setListShown(id, shown); }
+        return true;
+    case OP_ADD_BOOKMARK:
+        if (!in.str(name) || !in.bookmark(bm)) { return false; }
+        if (id == INVALID_LIST) { return true; }
+        if (BookmarkId existing = store.find(id, name); existing != INVALID_BOOKMARK) {
+            store.update(existing, name, bm);
+        }
+        else {
+            store.add(id, name, bm);
+        }
+        return true;
+    case OP_UPDATE_BOOKMARK:
+        if (!in.str(name) || !in.str(newName) || !in.bookmark(bm)) { return false; }
+        if (id == INVALID_LIST) { return true; }
+        if (BookmarkId existing = store.find(id, name); existing != INVALID_BOOKMARK) {
+            store.update(existing, newName, bm);
+        }
+        return true;
+    case OP_REMOVE_BOOKMARK:
+        if (!in.str(name)) { return false; }
+        if (id == INVALID_LIST) { return true; }
+        store.remove(store.find(id, name));
+        return true;
+    default:
+        return false;
+    }
+}
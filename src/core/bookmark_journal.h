@@ -0,0 +1,94 @@
+#pragma once
+#include "bookmark_store.h"
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Append-only log of the edits made since the bookmark database was last
+// written. Each edit is one small record, so persisting it costs the same no
+// matter how many bookmarks there are; the database is rewritten only when the
+// journal is compacted.
+//
+// Records refer to lists and bookmarks by name, since ids are renumbered when
+// the database is written, and carry an increasing sequence number. The
+// database stores the sequence number of the last record it includes, so
+// records that made it into the database are skipped on replay even if the
+// journal couldn't be trimmed before a crash.
+//
+// Recording edits and writing them are split so they can happen on different
+// threads: the thread owning the store records edits and takes the encoded
+// records, another one writes them with write(). open() and close() must not
+// run concurrently with either.
+class EditJournal {
+public:
+    ~EditJournal();
+
+    // Opens or creates the journal and applies the records newer than
+    // `dbSequence` to the store. A damaged tail, as left by a crash in the
+    // middle of a write, is cut off. Returns the number of records applied.
+    // A journal that can't be read at all is renamed to <path>.bad and a new
+    // one started; open() then succeeds with `error` saying so.
+    bool open(const std::string& path, BookmarkStore& store, uint64_t dbSequence, size_t& replayed, std::string& error);
+    void close();
+
+    // Record one edit each, done before the edit is applied to the store.
+    // Records are only durable once written.
+    void addList(std::string_view list, uint32_t color, bool shown);
+    void removeList(std::string_view list);
+    void renameList(std::string_view list, std::string_view newName);
+    void setListColor(std::string_view list, uint32_t color);
+    void setListShown(std::string_view list, bool shown);
+    void addBookmark(std::string_view list, std::string_view name, const FrequencyBookmark& bm);
+    void updateBookmark(std::string_view list, std::string_view name, std::string_view newName, const FrequencyBookmark& bm);
+    void removeBookmark(std::string_view list, std::string_view name);
+
+    // Sequence number of the last record
+    uint64_t sequence() const { return seq; }
+
+    // Hands over the records encoded since the last call
+    bool hasPending() const { return !pending.empty(); }
+    std::vector<uint8_t> takePending();
+
+    // Appends encoded records and flushes them to the disk
+    bool write(const std::vector<uint8_t>& records);
+
+    // Writes the pending records on the calling thread
+    bool sync() { return write(takePending()); }
+
+    // Drops every record written so far, once the database includes them
+    bool truncate(std::string& error);
+
+    // Size of the file in bytes, for the writing thread
+    size_t fileBytes() const { return fileSize; }
+
+private:
+    enum Op : uint8_t {
+        OP_ADD_LIST = 1,
+        OP_REMOVE_LIST,
+        OP_RENAME_LIST,
+        OP_SET_LIST_COLOR,
+        OP_SET_LIST_SHOWN,
+        OP_ADD_BOOKMARK,
+        OP_UPDATE_BOOKMARK,
+        OP_REMOVE_BOOKMARK
+    };
+
+    size_t beginRecord(Op op);
+    void endRecord(size_t start);
+    void putU8(uint8_t val);
+    void putU32(uint32_t val);
+    void putU64(uint64_t val);
+    void putDouble(double val);
+    void putString(std::string_view str);
+    void putBookmark(const FrequencyBookmark& bm);
+
+    bool writeHeader(FILE* f);
+    static bool apply(BookmarkStore& store, const uint8_t* data, size_t size);
+
+    std::string path;
+    FILE* file = NULL;
+    size_t fileSize = 0;
+    uint64_t seq = 0;
+    std::vector<uint8_t> pending;
+};
@@ -0,0 +1,179 @@
+#include "bookmark_search.h"
+#include "text_fold.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+    // Candidates checked between two looks at the clock
+    constexpr size_t CLOCK_STRIDE = 256;
+
+    // Matches kept per step, bounding the sort that merges them in
+    constexpr size_t MAX_FOUND_PER_STEP = 4096;
+
+    void appendTrigrams(const char* text, std::vector<uint32_t>& out) {
+        if (!text[0] || !text[1]) { return; }
+        uint32_t gram = ((uint32_t)fold(text[0]) << 8) | fold(text[1]);
+        for (size_t i = 2; text[i]; i++) {
+            gram = ((gram << 8) | fold(text[i])) & 0xFFFFFF;
+            out.push_back(gram);
+        }
+    }
+}
+
+bool SearchFilter::active() const {
+    return !text.empty() || mode >= 0 || minFrequency > 0.0 || maxFrequency > 0.0 || onlineOnly;
+}
+
+bool SearchFilter::operator==(const SearchFilter& other) const {
+    return text == other.text && mode == other.mode && minFrequency == other.minFrequency &&
+           maxFrequency == other.maxFrequency && onlineOnly == other.onlineOnly;
+}
+
+void SearchIndex::build(const BookmarkStore& store) {
+    clear();
+    // Ids are visited in order, so appending keeps every posting list sorted
+    for (BookmarkId id = 0; id < store.capacity(); id++) {
+        if (!store.valid(id)) { continue; }
+        trigrams(store, id, scratch);
+        for (uint32_t gram : scratch) { postings[gram].push_back(id); }
+    }
+}
+
+void SearchIndex::clear() {
+    postings.clear();
+}
+
+void SearchIndex::add(const BookmarkStore& store, BookmarkId id) {
+    trigrams(store, id, scratch);
+    for (uint32_t gram : scratch) {
+        std::vector<BookmarkId>& ids = postings[gram];
+        if (ids.empty() || ids.back() < id) {
+            ids.push_back(id);
+            continue;
+        }
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        if (it == ids.end() || *it != id) { ids.insert(it, id); }
+    }
+}
+
+void SearchIndex::remove(const BookmarkStore& store, BookmarkId id) {
+    trigrams(store, id, scratch);
+    for (uint32_t gram : scratch) {
+        auto pit = postings.find(gram);
+        if (pit == postings.end()) { continue; }
+        std::vector<BookmarkId>& ids = pit->second;
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        if (it != ids.end() && *it == id) { ids.erase(it); }
+        if (ids.empty()) { postings.erase(pit); }
+    }
+}
+
+bool SearchIndex::candidates(const std::string& folded, std::vector<BookmarkId>& out) const {
+    out.clear();
+    if (folded.size() < 3) { return false; }
+
+    std::vector<uint32_t> grams;
+    appendTrigrams(folded.c_str(), grams);
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+
+    // Intersect starting from the rarest trigram so the working set only shrinks
+    std::vector<const std::vector<BookmarkId>*> lists;
+    for (uint32_t gram : grams) {
+        auto it = postings.find(gram);
+        if (it == postings.end()) { return true; }
+        lists.push_back(&it->second);
+    }
+    std::sort(lists.begin(), lists.end(), [](auto a, auto b) { return a->size() < b->size(); });
+
+    out = *lists[0];
+    for (size_t i = 1; i < lists.size() && !out.empty(); i++) {
+        const std::vector<BookmarkId>& ids = *lists[i];
+        auto from = ids.begin();
+        size_t kept = 0;
+        for (BookmarkId id : out) {
+            from = std::lower_bound(from, ids.end(), id);
+            if (from == ids.end()) { break; }
+            if (*from == id) { out[kept++] = id; }
+        }
+        out.resize(kept);
+    }
+    return true;
+}
+
+size_t SearchIndex::memoryUsage() const {
+    size_t total = postings.bucket_count() * sizeof(void*);
+    for (auto const& [gram, ids] : postings) {
+        total += sizeof(gram) + sizeof(ids) + ids.capacity() * sizeof(BookmarkId);
+    }
+    return total;
+}
+
+void SearchIndex::trigrams(const BookmarkStore& store, BookmarkId id, std::vector<uint32_t>& out) {
+    out.clear();
+    appendTrigrams(store.name(id), out);
+    appendTrigrams(store.notes(id), out);
+    appendTrigrams(store.geoinfo(id), out);
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+void BookmarkSearch::start(const SearchIndex& index, const BookmarkStore& store, const SearchFilter& filter) {
+    current = filter;
+    folded = foldText(filter.text);
+    found.clear();
+    scanAll = !index.candidates(folded, pending);
+    next = 0;
+    end = scanAll ? store.capacity() : pending.size();
+    finished = false;
+}
+
+void BookmarkSearch::clear() {
+    current = SearchFilter();
+    folded.clear();
+    pending.clear();
+    found.clear();
+    next = end = 0;
+    finished = true;
+}
+
+bool BookmarkSearch::step(const BookmarkStore& store, const ScheduleEngine& schedule, double budgetMs) {
+    if (finished) { return true; }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(budgetMs);
+    size_t oldCount = found.size();
+    while (next < end) {
+        size_t stop = std::min(end, next + CLOCK_STRIDE);
+        for (; next < stop; next++) {
+            BookmarkId id = scanAll ? (BookmarkId)next : pending[next];
+            if (matches(store, schedule, id)) { found.push_back(id); }
+        }
+        if (found.size() - oldCount >= MAX_FOUND_PER_STEP) { break; }
+        if (next < end && std::chrono::steady_clock::now() >= deadline) { break; }
+    }
+
+    // Sort only what this step found and merge it in, so the results are
+    // always in order and no single step sorts all of them
+    auto byFrequency = [&store](BookmarkId a, BookmarkId b) {
+        return store.frequency(a) < store.frequency(b);
+    };
+    std::sort(found.begin() + oldCount, found.end(), byFrequency);
+    std::inplace_merge(found.begin(), found.begin() + oldCount, found.end(), byFrequency);
+
+    if (next < end) { return false; }
+    pending.clear();
+    finished = true;
+    return true;
+}
+
+bool BookmarkSearch::matches(const BookmarkStore& store, const ScheduleEngine& schedule, BookmarkId id) const {
+    if (!store.valid(id)) { return false; }
+    if (current.mode >= 0 && store.mode(id) != current.mode) { return false; }
+    double freq = store.frequency(id);
+    if (current.minFrequency > 0.0 && freq < current.minFrequency) { return false; }
+    if (current.maxFrequency > 0.0 && freq > current.maxFrequency) { return false; }
+    if (current.onlineOnly && !schedule.online(id)) { return false; }
+    if (folded.empty()) { return true; }
+    return containsFolded(store.name(id), folded) || containsFolded(store.notes(id), folded) ||
+           containsFolded(store.geoinfo(id), folded);
+}
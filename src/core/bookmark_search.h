@@ -0,0 +1,76 @@
+#pragma once
+#include "bookmark_store.h"
+#include "schedule.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+struct SearchFilter {
+    std::string text; // Matched case-insensitively against name, notes and geoinfo
+    int mode = -1; // -1 for any mode
+    double minFrequency = 0.0;
+    double maxFrequency = 0.0; // 0 for no upper bound
+    bool onlineOnly = false;
+
+    bool active() const;
+    bool operator==(const SearchFilter& other) const;
+    bool operator!=(const SearchFilter& other) const { return !(*this == other); }
+};
+
+// Trigram index over the lowercased name, notes and geoinfo of every bookmark
+// of a store. Each trigram maps to the sorted ids of the bookmarks containing
+// it, so a query only looks at bookmarks that have all of its trigrams.
+//
+// Trigrams are computed from the store, so a bookmark must be removed before
+// its text changes in the store and added again after.
+class SearchIndex {
+public:
+    void build(const BookmarkStore& store);
+    void clear();
+    void add(const BookmarkStore& store, BookmarkId id);
+    void remove(const BookmarkStore& store, BookmarkId id);
+
+    // Sorted ids of the bookmarks containing every trigram of `folded`, which
+    // must already be lowercase. Returns false when the text is too short to
+    // narrow anything down, in which case every bookmark is a candidate.
+    bool candidates(const std::string& folded, std::vector<BookmarkId>& out) const;
+
+    size_t memoryUsage() const;
+
+private:
+    static void trigrams(const BookmarkStore& store, BookmarkId id, std::vector<uint32_t>& out);
+
+    std::unordered_map<uint32_t, std::vector<BookmarkId>> postings;
+    std::vector<uint32_t> scratch;
+};
+
+// A search over a store that checks its candidates a budget at a time, so
+// typing never costs more than a slice of a frame and results show up as they
+// are found. Any edit of the store must restart the search.
+class BookmarkSearch {
+public:
+    void start(const SearchIndex& index, const BookmarkStore& store, const SearchFilter& filter);
+    void clear();
+
+    // Checks candidates until all are done or `budgetMs` is spent. Returns true when done.
+    bool step(const BookmarkStore& store, const ScheduleEngine& schedule, double budgetMs);
+
+    bool running() const { return !finished; }
+    const SearchFilter& filter() const { return current; }
+
+    // Ordered by frequency, also while the search is still running
+    const std::vector<BookmarkId>& results() const { return found; }
+
+private:
+    bool matches(const BookmarkStore& store, const ScheduleEngine& schedule, BookmarkId id) const;
+
+    SearchFilter current;
+    std::string folded;
+    std::vector<BookmarkId> pending; // Only used when the index narrowed the search
+    bool scanAll = false;
+    size_t next = 0;
+    size_t end = 0;
+    std::vector<BookmarkId> found;
+    bool finished = true;
+};
@@ -0,0 +1,299 @@
+#include "bookmark_store.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    constexpr BookmarkId EMPTY_SLOT = UINT32_MAX;
+    constexpr BookmarkId DELETED_SLOT = UINT32_MAX - 1;
+}
+
+StringHeap::StringHeap() {
+    data.push_back(0);
+}
+
+uint32_t StringHeap::add(std::string_view str) {
+    if (str.empty()) { return 0; }
+    uint32_t offset = data.size();
+    data.insert(data.end(), str.begin(), str.end());
+    data.push_back(0);
+    return offset;
+}
+
+void StringHeap::release(uint32_t offset) {
+    if (offset == 0) { return; }
+    unused += strlen(data.data() + offset) + 1;
+}
+
+void StringHeap::clear() {
+    data.clear();
+    data.push_back(0);
+    unused = 0;
+}
+
+void StringHeap::assign(const char* heap, size_t size) {
+    data.assign(heap, heap + size);
+    unused = 0;
+}
+
+void BookmarkStore::clear() {
+    uint64_t next = epoch + 1;
+    *this = BookmarkStore();
+    epoch = next;
+}
+
+ListId BookmarkStore::addList(const std::string& name, uint32_t color, bool shown) {
+    BookmarkList list = { name, color, shown, true };
+    for (size_t i = 0; i < lists.size(); i++) {
+        if (!lists[i].alive) {
+            lists.edit()[i] = list;
+            return i;
+        }
+    }
+    lists.edit().push_back(list);
+    return lists.size() - 1;
+}
+
+ListId BookmarkStore::findList(std::string_view name) const {
+    for (size_t i = 0; i < lists.size(); i++) {
+        if (lists[i].alive && lists[i].name == name) { return i; }
+    }
+    return INVALID_LIST;
+}
+
+void BookmarkStore::removeList(ListId list) {
+    for (BookmarkId id = 0; id < listIds.size(); id++) {
+        if (listIds[id] == list) { remove(id); }
+    }
+    lists.edit()[list].alive = false;
+    lists.edit()[list].name.clear();
+}
+
+void BookmarkStore::renameList(ListId list, const std::string& name) {
+    lists.edit()[list].name = name;
+}
+
+void BookmarkStore::setListColor(ListId list, uint32_t color) {
+    lists.edit()[list].color = color;
+}
+
+void BookmarkStore::setListShown(ListId list, bool shown) {
+    lists.edit()[list].shown = shown;
+}
+
+BookmarkId BookmarkStore::add(ListId list, std::string_view name, const FrequencyBookmark& bm) {
+    BookmarkId id;
+    if (!freeIds.empty()) {
+        id = freeIds[freeIds.size() - 1];
+        freeIds.edit().pop_back();
+    }
+    else {
+        id = listIds.size();
+        listIds.edit().push_back(INVALID_LIST);
+        frequencies.edit().push_back(0);
+        bandwidths.edit().push_back(0);
+        modes.edit().push_back(0);
+        startTimes.edit().push_back(0);
+        endTimes.edit().push_back(0);
+        dayMasks.edit().push_back(0);
+        names.edit().push_back(0);
+        notesOffsets.edit().push_back(0);
+        geoinfoOffsets.edit().push_back(0);
+    }
+
+    listIds.edit()[id] = list;
+    setFields(id, name, bm);
+    nameInsert(id);
+    count++;
+    return id;
+}
+
+void BookmarkStore::update(BookmarkId id, std::string_view name, const FrequencyBookmark& bm) {
+    nameErase(id);
+    releaseStrings(id);
+    setFields(id, name, bm);
+    nameInsert(id);
+    compactStrings();
+}
+
+void BookmarkStore::remove(BookmarkId id) {
+    if (!valid(id)) { return; }
+    nameErase(id);
+    releaseStrings(id);
+    listIds.edit()[id] = INVALID_LIST;
+    names.edit()[id] = 0;
+    notesOffsets.edit()[id] = 0;
+    geoinfoOffsets.edit()[id] = 0;
+    freeIds.edit().push_back(id);
+    count--;
+    epoch++;
+    compactStrings();
+}
+
+BookmarkId BookmarkStore::find(ListId list, std::string_view name) const {
+    if (nameSlots.empty()) { return INVALID_BOOKMARK; }
+    size_t mask = nameSlots.size() - 1;
+    for (size_t i = hashName(list, name) & mask;; i = (i + 1) & mask) {
+        BookmarkId id = nameSlots[i];
+        if (id == EMPTY_SLOT) { return INVALID_BOOKMARK; }
+        if (id != DELETED_SLOT && listIds[id] == list && name == this->name(id)) { return id; }
+    }
+}
+
+FrequencyBookmark BookmarkStore::get(BookmarkId id) const {
+    FrequencyBookmark bm;
+    bm.frequency = frequencies[id];
+    bm.bandwidth = bandwidths[id];
+    bm.mode = modes[id];
+    bm.startTime = startTimes[id];
+    bm.endTime = endTimes[id];
+    maskToDays(dayMasks[id], bm.days);
+    bm.notes = notes(id);
+    bm.geoinfo = geoinfo(id);
+    return bm;
+}
+
+size_t BookmarkStore::memoryUsage() const {
+    size_t total = 0;
+    for (auto const& list : lists.get()) {
+        total += sizeof(BookmarkList) + list.name.capacity();
+    }
+    total += listIds.capacity() * sizeof(ListId);
+    total += frequencies.capacity() * sizeof(double);
+    total += bandwidths.capacity() * sizeof(double);
+    total += modes.capacity() * sizeof(uint8_t);
+    total += startTimes.capacity() * sizeof(int16_t);
+    total += endTimes.capacity() * sizeof(int16_t);
+    total += dayMasks.capacity() * sizeof(uint8_t);
+    total += names.capacity() * sizeof(uint32_t);
+    total += notesOffsets.capacity() * sizeof(uint32_t);
+    total += geoinfoOffsets.capacity() * sizeof(uint32_t);
+    total += freeIds.capacity() * sizeof(BookmarkId);
+    total += nameSlots.capacity() * sizeof(BookmarkId);
+    total += strings.get().memoryUsage();
+    return total;
+}
+
+void BookmarkStore::setFields(BookmarkId id, std::string_view name, const FrequencyBookmark& bm) {
+    frequencies.edit()[id] = bm.frequency;
+    bandwidths.edit()[id] = bm.bandwidth;
+    modes.edit()[id] = bm.mode;
+    startTimes.edit()[id] = bm.startTime;
+    endTimes.edit()[id] = bm.endTime;
+    dayMasks.edit()[id] = daysToMask(bm.days);
+    StringHeap& heap = strings.edit();
+    names.edit()[id] = heap.add(name);
+    notesOffsets.edit()[id] = heap.add(bm.notes);
+    geoinfoOffsets.edit()[id] = heap.add(bm.geoinfo);
+}
+
+void BookmarkStore::releaseStrings(BookmarkId id) {
+    StringHeap& heap = strings.edit();
+    heap.release(names[id]);
+    heap.release(notesOffsets[id]);
+    heap.release(geoinfoOffsets[id]);
+}
+
+void BookmarkStore::compactStrings() {
+    // Rewrite the heap once more than half of it is unused
+    const StringHeap& heap = strings.get();
+    if (heap.garbage() < 4096 || heap.garbage() * 2 < heap.size()) { return; }
+
+    StringHeap compacted;
+    std::vector<uint32_t>& nameCol = names.edit();
+    std::vector<uint32_t>& notesCol = notesOffsets.edit();
+    std::vector<uint32_t>& geoinfoCol = geoinfoOffsets.edit();
+    for (BookmarkId id = 0; id < listIds.size(); id++) {
+        if (listIds[id] == INVALID_LIST) { continue; }
+        nameCol[id] = compacted.add(heap.get(nameCol[id]));
+        notesCol[id] = compacted.add(heap.get(notesCol[id]));
+        geoinfoCol[id] = compacted.add(heap.get(geoinfoCol[id]));
+    }
+    strings.reset(std::move(compacted));
+}
+
+uint64_t BookmarkStore::hashName(ListId list, std::string_view name) const {
+    // FNV-1a, seeded with the list id
+    uint64_t hash = 14695981039346656037ULL ^ list;
+    for (char c : name) {
+        hash ^= (uint8_t)c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void BookmarkStore::nameInsert(BookmarkId id) {
+    // Keep the table at most half full, counting deleted slots. The id is
+    // already live, so rebuilding the table also inserts it.
+    if ((nameSlotsUsed + 1) * 2 > nameSlots.size()) {
+        nameRehash(std::max<size_t>(64, (count + 1) * 2));
+        return;
+    }
+    std::vector<BookmarkId>& slots = nameSlots.edit();
+    size_t mask = slots.size() - 1;
+    for (size_t i = hashName(listIds[id], name(id)) & mask;; i = (i + 1) & mask) {
+        if (slots[i] == EMPTY_SLOT) {
+            slots[i] = id;
+            nameSlotsUsed++;
+            return;
+        }
+    }
+}
+
+void BookmarkStore::nameErase(BookmarkId id) {
+    if (nameSlots.empty()) { return; }
+    size_t mask = nameSlots.size() - 1;
+    for (size_t i = hashName(listIds[id], name(id)) & mask;; i = (i + 1) & mask) {
+        if (nameSlots[i] == EMPTY_SLOT) { return; }
+        if (nameSlots[i] == id) {
+            nameSlots.edit()[i] = DELETED_SLOT;
+            return;
+        }
+    }
+}
+
+void BookmarkStore::nameRehash(size_t slotCount) {
+    size_t size = 1;
+    while (size < slotCount) { size <<= 1; }
+
+    std::vector<BookmarkId> slots(size, EMPTY_SLOT);
+    nameSlotsUsed = 0;
+    size_t mask = size - 1;
+    for (BookmarkId id = 0; id < listIds.size(); id++) {
+        if (listIds[id] == INVALID_LIST) { continue; }
+        for (size_t i = hashName(listIds[id], name(id)) & mask;; i = (i + 1) & mask) {
+            if (slots[i] == EMPTY_SLOT) {
+                slots[i] = id;
+                nameSlotsUsed++;
+                break;
+            }
+        }
+    }
+    nameSlots.reset(std::move(slots));
+}
+
+void storeFromJson(BookmarkStore& store, const json& lists) {
+    store.clear();
+    for (auto const& [listName, list] : lists.items()) {
+        uint32_t color = list.contains("color") ? hexStrToColor(list["color"]) : DEFAULT_LIST_COLOR;
+        ListId id = store.addList(listName, color, list["showOnWaterfall"]);
+        for (auto const& [bmName, bm] : list["bookmarks"].items()) {
+            store.add(id, bmName, bookmarkFromJson(bm));
+        }
+    }
+}
+
+json storeToJson(const BookmarkStore& store) {
+    json lists = json::object();
+    for (ListId list = 0; list < store.listCapacity(); list++) {
+        const BookmarkList& bl = store.getList(list);
+        if (!bl.alive) { continue; }
+        lists[bl.name]["showOnWaterfall"] = bl.shown;
+        lists[bl.name]["color"] = colorToHexStr(bl.color);
+        lists[bl.name]["bookmarks"] = json::object();
+    }
+    for (BookmarkId id = 0; id < store.capacity(); id++) {
+        if (!store.valid(id)) { continue; }
+        lists[store.getList(store.listOf(id)).name]["bookmarks"][store.name(id)] = bookmarkToJson(store.get(id));
+    }
+    return lists;
+}
@@ -0,0 +1,181 @@
+#pragma once
+#include "bookmark.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <atomic>
+
+typedef uint32_t BookmarkId;
+typedef uint16_t ListId;
+
+constexpr BookmarkId INVALID_BOOKMARK = UINT32_MAX;
+constexpr ListId INVALID_LIST = UINT16_MAX;
+
+// Append-only storage for NUL terminated strings, referenced by offset.
+// Offset 0 is always the empty string.
+class StringHeap {
+public:
+    StringHeap();
+
+    uint32_t add(std::string_view str);
+    const char* get(uint32_t offset) const { return data.data() + offset; }
+
+    // Marks the string as unused, the space is reclaimed by the owner compacting the heap
+    void release(uint32_t offset);
+
+    void clear();
+    // Replaces the content with a heap written by another StringHeap, which
+    // must start with the empty string and end with a NUL
+    void assign(const char* heap, size_t size);
+    const char* raw() const { return data.data(); }
+    size_t size() const { return data.size(); }
+    size_t garbage() const { return unused; }
+    size_t memoryUsage() const { return data.capacity(); }
+
+private:
+    std::vector<char> data;
+    size_t unused = 0;
+};
+
+// Value shared between copies of a store until one of them modifies it, which
+// makes copying a store cheap enough to hand snapshots to other threads.
+// Only the owning thread may call edit(); copies may be read from anywhere.
+template <class T>
+class CopyOnWrite {
+public:
+    CopyOnWrite() : ptr(std::make_shared<T>()) {}
+
+    const T& get() const { return *ptr; }
+
+    T& edit() {
+        if (ptr.use_count() > 1) {
+            ptr = std::make_shared<T>(*ptr);
+        }
+        else {
+            // Pairs with the release of the last other reference
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return *ptr;
+    }
+
+    void reset(T&& value) { ptr = std::make_shared<T>(std::move(value)); }
+
+private:
+    std::shared_ptr<T> ptr;
+};
+
+// Column of a store, see CopyOnWrite
+template <class T>
+class Column : public CopyOnWrite<std::vector<T>> {
+public:
+    const T& operator[](size_t i) const { return this->get()[i]; }
+    size_t size() const { return this->get().size(); }
+    size_t capacity() const { return this->get().capacity(); }
+    bool empty() const { return this->get().empty(); }
+};
+
+struct BookmarkList {
+    std::string name;
+    uint32_t color;
+    bool shown;
+    bool alive;
+};
+
+// Single in-memory copy of every bookmark of every list.
+//
+// Bookmarks are addressed by a BookmarkId that stays valid until the bookmark
+// is removed; ids of removed bookmarks get reused. Fields are kept in separate
+// columns so scans over one field (frequency for the waterfall, name for the
+// table) only touch that field. Strings live in a shared heap and list names
+// are stored once per list.
+//
+// Copies share their columns until modified, so a copy is a consistent
+// snapshot that can be read by another thread while this one keeps editing.
+class BookmarkStore {
+public:
+    void clear();
+
+    // Lists
+    ListId addList(const std::string& name, uint32_t color, bool shown);
+    ListId findList(std::string_view name) const;
+    void removeList(ListId list);
+    void renameList(ListId list, const std::string& name);
+    void setListColor(ListId list, uint32_t color);
+    void setListShown(ListId list, bool shown);
+    const BookmarkList& getList(ListId list) const { return lists[list]; }
+    size_t listCapacity() const { return lists.size(); }
+
+    // Bookmarks
+    BookmarkId add(ListId list, std::string_view name, const FrequencyBookmark& bm);
+    void update(BookmarkId id, std::string_view name, const FrequencyBookmark& bm);
+    void remove(BookmarkId id);
+    BookmarkId find(ListId list, std::string_view name) const;
+    FrequencyBookmark get(BookmarkId id) const;
+
+    bool valid(BookmarkId id) const { return id < listIds.size() && listIds[id] != INVALID_LIST; }
+    ListId listOf(BookmarkId id) const { return listIds[id]; }
+    double frequency(BookmarkId id) const { return frequencies[id]; }
+    double bandwidth(BookmarkId id) const { return bandwidths[id]; }
+    int mode(BookmarkId id) const { return modes[id]; }
+    int startTime(BookmarkId id) const { return startTimes[id]; }
+    int endTime(BookmarkId id) const { return endTimes[id]; }
+    uint8_t days(BookmarkId id) const { return dayMasks[id]; }
+    const char* name(BookmarkId id) const { return strings.get().get(names[id]); }
+    const char* notes(BookmarkId id) const { return strings.get().get(notesOffsets[id]); }
+    const char* geoinfo(BookmarkId id) const { return strings.get().get(geoinfoOffsets[id]); }
+    uint32_t color(BookmarkId id) const { return lists[listIds[id]].color; }
+
+    // Changes whenever ids are freed, after which they may be reused for other
+    // bookmarks. Ids kept from before a change may no longer mean the same
+    // bookmark even if they are valid.
+    uint64_t idEpoch() const { return epoch; }
+
+    // Upper bound of the ids in use, for sizing per-bookmark side tables
+    size_t capacity() const { return listIds.size(); }
+    size_t size() const { return count; }
+
+    size_t memoryUsage() const;
+
+private:
+    friend class BookmarkDatabase;
+
+    void setFields(BookmarkId id, std::string_view name, const FrequencyBookmark& bm);
+    void releaseStrings(BookmarkId id);
+    void compactStrings();
+
+    // Open addressing (list, name) -> id lookup
+    uint64_t hashName(ListId list, std::string_view name) const;
+    void nameInsert(BookmarkId id);
+    void nameErase(BookmarkId id);
+    void nameRehash(size_t slotCount);
+
+    Column<BookmarkList> lists;
+
+    Column<ListId> listIds; // INVALID_LIST for free ids
+    Column<double> frequencies;
+    Column<double> bandwidths;
+    Column<uint8_t> modes;
+    Column<int16_t> startTimes; // HHMM
+    Column<int16_t> endTimes; // HHMM
+    Column<uint8_t> dayMasks;
+    Column<uint32_t> names;
+    Column<uint32_t> notesOffsets;
+    Column<uint32_t> geoinfoOffsets;
+
+    Column<BookmarkId> freeIds;
+    size_t count = 0;
+    uint64_t epoch = 0;
+
+    CopyOnWrite<StringHeap> strings;
+
+    Column<BookmarkId> nameSlots;
+    size_t nameSlotsUsed = 0;
+};
+
+// The lists in the JSON layout of the old config file, also used for the JSON
+// copy kept next to the database
+void storeFromJson(BookmarkStore& store, const json& lists);
+json storeToJson(const BookmarkStore& store);
@@ -0,0 +1,81 @@
+#include "frame_governor.h"
+#include <algorithm>
+
+namespace {
+    // Weight of the newest frame in the smoothed cost
+    constexpr double SMOOTHING = 0.2;
+
+    // Frames over budget before dropping a level
+    constexpr int DEGRADE_FRAMES = 5;
+
+    // Frames under RESTORE_RATIO of the budget before coming back a level,
+    // doubled on each bounce up to the maximum
+    constexpr double RESTORE_RATIO = 0.5;
+    constexpr int MIN_RESTORE_FRAMES = 60;
+    constexpr int MAX_RESTORE_FRAMES = 60 * 64;
+
+    // Dropping again within this many frames of coming back is a bounce, and
+    // staying back for SETTLE_FRAMES forgets the previous bounces
+    constexpr int BOUNCE_FRAMES = 120;
+    constexpr int SETTLE_FRAMES = 60 * 30;
+}
+
+FrameGovernor::FrameGovernor() {
+    restoreFrames = MIN_RESTORE_FRAMES;
+    sinceRestore = SETTLE_FRAMES;
+}
+
+void FrameGovernor::setBudget(double ms) {
+    budgetMs = std::max(ms, 0.0);
+    if (budgetMs == 0.0) {
+        change(DETAIL_FULL);
+        restoreFrames = MIN_RESTORE_FRAMES;
+        sinceRestore = SETTLE_FRAMES;
+    }
+}
+
+bool FrameGovernor::frame(double ms) {
+    if (budgetMs == 0.0) { return false; }
+
+    smoothed = measured ? smoothed + SMOOTHING * (ms - smoothed) : ms;
+    measured = true;
+    if (sinceRestore < SETTLE_FRAMES && ++sinceRestore == SETTLE_FRAMES) {
+        restoreFrames = MIN_RESTORE_FRAMES;
+    }
+
+    overFrames = (smoothed > budgetMs) ? overFrames + 1 : 0;
+    underFrames = (smoothed < budgetMs * RESTORE_RATIO) ? underFrames + 1 : 0;
+
+    if (overFrames >= DEGRADE_FRAMES && level + 1 < _DETAIL_COUNT) {
+        if (sinceRestore < BOUNCE_FRAMES) {
+            restoreFrames = std::min(restoreFrames * 2, MAX_RESTORE_FRAMES);
+        }
+        change((OverlayDetail)(level + 1));
+        return true;
+    }
+    if (underFrames >= restoreFrames && level > DETAIL_FULL) {
+        change((OverlayDetail)(level - 1));
+        sinceRestore = 0;
+        return true;
+    }
+    return false;
+}
+
+void FrameGovernor::change(OverlayDetail detail) {
+    // Costs of the previous level say nothing about the new one
+    level = detail;
+    measured = false;
+    overFrames = 0;
+    underFrames = 0;
+}
+
+const char* overlayDetailName(OverlayDetail detail) {
+    switch (detail) {
+    case DETAIL_FULL: return "Full";
+    case DETAIL_NO_RECTANGLES: return "No rectangles";
+    case DETAIL_NO_TEXT: return "No text";
+    case DETAIL_TICKS: return "Ticks";
+    case DETAIL_CLUSTERS: return "Clusters";
+    default: return "";
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+// Levels of detail of the waterfall overlay, each cheaper than the one before
+enum OverlayDetail {
+    DETAIL_FULL, // As configured
+    DETAIL_NO_RECTANGLES,
+    DETAIL_NO_TEXT, // Lines only, still stacked in rows
+    DETAIL_TICKS, // A short tick per bookmark, on a single row
+    DETAIL_CLUSTERS, // Ticks, with crowded bookmarks grouped
+    _DETAIL_COUNT
+};
+
+// Picks the overlay detail that keeps drawing it within a time budget per
+// frame. The cost of each frame is smoothed; the detail drops a level once
+// the smoothed cost has been over budget for a few frames, and comes back a
+// level once it has stayed under half the budget for a second or so.
+//
+// A level that comes back only to drop again shortly after makes the next
+// comeback wait twice as long, so a view costing about the budget settles on
+// the cheaper level instead of flickering between the two.
+class FrameGovernor {
+public:
+    FrameGovernor();
+
+    // 0 turns the governor off, which keeps the full detail
+    void setBudget(double ms);
+    double budget() const { return budgetMs; }
+
+    // Cost of the frame just drawn. Returns true if the detail changed.
+    bool frame(double ms);
+
+    OverlayDetail detail() const { return level; }
+    double cost() const { return smoothed; }
+
+private:
+    void change(OverlayDetail detail);
+
+    double budgetMs = 0.0;
+    double smoothed = 0.0;
+    bool measured = false; // Whether `smoothed` holds a cost of the current level
+    OverlayDetail level = DETAIL_FULL;
+    int overFrames = 0;
+    int underFrames = 0;
+    int restoreFrames; // Frames under budget before coming back a level
+    int sinceRestore;
+};
+
+const char* overlayDetailName(OverlayDetail detail);
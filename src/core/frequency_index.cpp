@@ -0,0 +1,33 @@
+#include "frequency_index.h"
+#include <algorithm>
+
+void FrequencyIndex::clear() {
+    frequencies.clear();
+}
+
+void FrequencyIndex::reserve(size_t count) {
+    frequencies.reserve(count);
+}
+
+void FrequencyIndex::push(double frequency) {
+    frequencies.push_back(frequency);
+}
+
+std::pair<size_t, size_t> FrequencyIndex::range(double lowFreq, double highFreq) const {
+    if (highFreq < lowFreq) { return { 0, 0 }; }
+    auto first = std::lower_bound(frequencies.begin(), frequencies.end(), lowFreq);
+    auto last = std::upper_bound(first, frequencies.end(), highFreq);
+    return { (size_t)(first - frequencies.begin()), (size_t)(last - frequencies.begin()) };
+}
+
+size_t FrequencyIndex::insertPos(double frequency) const {
+    return std::upper_bound(frequencies.begin(), frequencies.end(), frequency) - frequencies.begin();
+}
+
+void FrequencyIndex::insert(size_t pos, double frequency) {
+    frequencies.insert(frequencies.begin() + pos, frequency);
+}
+
+void FrequencyIndex::erase(size_t pos) {
+    frequencies.erase(frequencies.begin() + pos);
+}
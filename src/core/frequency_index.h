@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+// Sorted frequency column of the waterfall bookmarks. It mirrors the order of
+// the bookmark vector it was built from, so a visible span can be turned into
+// an index range with two binary searches instead of a scan of the whole list.
+class FrequencyIndex {
+public:
+    void clear();
+    void reserve(size_t count);
+
+    // Frequencies must be pushed in ascending order
+    void push(double frequency);
+
+    // Returns the [first, last) range of entries with lowFreq <= frequency <= highFreq
+    std::pair<size_t, size_t> range(double lowFreq, double highFreq) const;
+
+    // Position a new entry with the given frequency must be inserted at to
+    // keep the order, after any existing entries of equal frequency
+    size_t insertPos(double frequency) const;
+
+    void insert(size_t pos, double frequency);
+    void erase(size_t pos);
+
+    size_t size() const { return frequencies.size(); }
+
+private:
+    std::vector<double> frequencies;
+};
@@ -0,0 +1,94 @@
+#include "label_layout.h"
+#include <algorithm>
+#include <limits>
+
+void RowPacker::reset(int rows, bool noClutter) {
+    this->rows = std::max<int>(rows, 0);
+    this->noClutter = noClutter;
+    rightEdges.assign(this->rows + 1, -std::numeric_limits<double>::infinity());
+}
+
+bool RowPacker::overlaps(int row, double min) const {
+    // Labels come in ascending centre order, so the new label always ends at or
+    // after the start of the right-most label on the row. The closed intervals
+    // therefore intersect exactly when it starts before the row's right edge.
+    return min <= rightEdges[row];
+}
+
+int RowPacker::findRow(double min) const {
+    for (int i = 0; i < rows; i++) {
+        if (!overlaps(i, min)) { return i; }
+    }
+
+    // Avoid clutter on the last row
+    if (noClutter && overlaps(rows, min)) { return -1; }
+    return rows;
+}
+
+void RowPacker::occupy(int row, double max) {
+    rightEdges[row] = std::max<double>(rightEdges[row], max);
+}
+
+void LabelHitIndex::reset(int rows) {
+    this->rows.resize(std::max<int>(rows, 0) + 1);
+    for (auto& row : this->rows) {
+        row.entries.clear();
+        row.minY = std::numeric_limits<float>::infinity();
+        row.maxY = -std::numeric_limits<float>::infinity();
+        row.sorted = true;
+    }
+    count = 0;
+}
+
+void LabelHitIndex::add(int row, float minX, float minY, float maxX, float maxY, size_t item) {
+    if (row < 0 || row >= (int)rows.size()) { return; }
+    Row& r = rows[row];
+    if (!r.entries.empty() && minX < r.entries.back().minX) { r.sorted = false; }
+    r.entries.push_back({ minX, maxX, minY, maxY, maxX, count++, item });
+    r.minY = std::min<float>(r.minY, minY);
+    r.maxY = std::max<float>(r.maxY, maxY);
+}
+
+void LabelHitIndex::finish() {
+    for (auto& row : rows) {
+        // Centered labels of different widths can start out of order. Ties
+        // keep the drawing order, without the buffer std::stable_sort allocates.
+        if (!row.sorted) {
+            std::sort(row.entries.begin(), row.entries.end(), [](const Entry& a, const Entry& b) {
+                return (a.minX != b.minX) ? a.minX < b.minX : a.order < b.order;
+            });
+            row.sorted = true;
+        }
+        float reach = -std::numeric_limits<float>::infinity();
+        for (auto& e : row.entries) {
+            reach = std::max<float>(reach, e.maxX);
+            e.reach = reach;
+        }
+    }
+}
+
+size_t LabelHitIndex::find(float x, float y) const {
+    size_t item = NONE;
+    uint32_t best = 0;
+    for (auto const& row : rows) {
+        if (y < row.minY || y >= row.maxY) { continue; }
+
+        // Last label starting at or before x, then back over the ones still reaching x
+        auto it = std::upper_bound(row.entries.begin(), row.entries.end(), x, [](float x, const Entry& e) {
+            return x < e.minX;
+        });
+        while (it != row.entries.begin()) {
+            --it;
+            if (it->reach <= x) { break; }
+            if (x < it->maxX && y >= it->minY && y < it->maxY && (item == NONE || it->order > best)) {
+                item = it->item;
+                best = it->order;
+            }
+        }
+    }
+    return item;
+}
+
+bool LabelHitIndex::empty() const {
+    return count == 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Assigns waterfall labels to rows. Labels must be placed in ascending
+// frequency order: a label then either overlaps the right-most label already
+// placed on a row or lies entirely to its right, so each row only needs to
+// remember its right edge and placing a label costs O(rows).
+//
+// There are `rows` regular rows plus one overflow row (index `rows`) that
+// takes every label that didn't fit elsewhere. With noClutter, labels that
+// would overlap on the overflow row are rejected instead.
+class RowPacker {
+public:
+    void reset(int rows, bool noClutter);
+
+    // Returns the row for a label starting at `min`, or -1 if it has to be skipped
+    int findRow(double min) const;
+
+    // Marks the label as drawn on the row returned by findRow()
+    void occupy(int row, double max);
+
+private:
+    bool overlaps(int row, double min) const;
+
+    int rows = 0;
+    bool noClutter = false;
+    std::vector<double> rightEdges;
+};
+
+// Finds the label under the mouse among the rectangles of the last layout.
+// Labels are bucketed by row and sorted by left edge, so a lookup is a binary
+// search per row plus a short walk back over labels that still reach the point
+// (only the overflow row can have overlapping labels).
+class LabelHitIndex {
+public:
+    static constexpr size_t NONE = (size_t)-1;
+
+    void reset(int rows);
+
+    // Labels must be added in drawing order. `item` is returned by find().
+    void add(int row, float minX, float minY, float maxX, float maxY, size_t item);
+
+    // Must be called after the last add() and before find()
+    void finish();
+
+    // Item of the label drawn last (so on top) at the point, or NONE.
+    // Rectangles include their top-left edges but not their bottom-right ones.
+    size_t find(float x, float y) const;
+
+    bool empty() const;
+
+private:
+    struct Entry {
+        float minX, maxX;
+        float minY, maxY;
+        float reach; // Largest maxX of this entry and all the ones before it
+        uint32_t order;
+        size_t item;
+    };
+
+    struct Row {
+        std::vector<Entry> entries;
+        float minY, maxY;
+        bool sorted;
+    };
+
+    std::vector<Row> rows;
+    uint32_t count = 0;
+};
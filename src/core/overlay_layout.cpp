@@ -0,0 +1,267 @@
+#include "overlay_layout.h"
+#include "bookmark_clusters.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cfloat>
+
+namespace {
+    // Width of a cluster bucket on screen, in multiples of the font size
+    constexpr float CLUSTER_SPACING_EM = 5.0f;
+
+    // Color of the bookmarks of a cluster that are not in its main lists
+    constexpr ImU32 CLUSTER_OTHER_COLOR = IM_COL32(160, 160, 160, 255);
+
+    // Most vertices and indices ImGui emits per primitive, for reserving draw list space
+    constexpr int RECT_VERTICES = 4;
+    constexpr int RECT_INDICES = 6;
+    constexpr int LINE_VERTICES = 6; // Anti-aliased without the line texture
+    constexpr int LINE_INDICES = 12;
+    constexpr int GLYPH_VERTICES = 4;
+    constexpr int GLYPH_INDICES = 6;
+
+    // Cluster counts are only made of digits, measured ahead by measureDigits()
+    ImVec2 measureCount(const OverlayOptions& options, const char* text) {
+        float width = 0.0f;
+        for (const char* c = text; *c; c++) {
+            width += options.digitWidths[*c - '0'];
+        }
+        return ImVec2(std::floor(width + 0.99999f), options.fontSize);
+    }
+}
+
+ImVec2 measureLabel(const ImFont* font, float fontSize, const char* text) {
+    // Same as ImGui::CalcTextSize(), without going through the ImGui context
+    ImVec2 size = font->CalcTextSizeA(fontSize, FLT_MAX, 0.0f, text);
+    size.x = std::floor(size.x + 0.99999f);
+    return size;
+}
+
+void measureDigits(OverlayOptions& options, const ImFont* font) {
+    char digit[2] = { '0', 0 };
+    for (int i = 0; i < 10; i++, digit[0]++) {
+        options.digitWidths[i] = font->CalcTextSizeA(options.fontSize, FLT_MAX, 0.0f, digit).x;
+    }
+}
+
+float panOffset(const OverlayView& from, const OverlayView& to) {
+    if (from.min.x != to.min.x || from.min.y != to.min.y || from.max.x != to.max.x || from.max.y != to.max.y) { return NAN; }
+    // Panning moves both edges by the same amount, up to rounding
+    double span = to.highFreq - to.lowFreq;
+    if (std::fabs((from.highFreq - from.lowFreq) - span) > span * 1e-9) { return NAN; }
+    if (std::fabs(from.freqToPixelRatio - to.freqToPixelRatio) > to.freqToPixelRatio * 1e-9) { return NAN; }
+    return (float)((from.lowFreq - to.lowFreq) * to.freqToPixelRatio);
+}
+
+void OverlayLayout::layout(const ScheduleEngine& schedule, const std::vector<WaterfallBookmark>& bookmarks, const FrequencyIndex& index,
+                           const OverlayView& view, const OverlayOptions& options, const ClusterHierarchy* clusters) {
+    drawCmds.clear();
+    clusterCmds.clear();
+    vertexCount = 0;
+    indexCount = 0;
+
+    rowPacker.reset(options.rows, options.noClutter);
+    hitIndex.reset(options.rows);
+
+    // Only visit the bookmarks that fall inside the displayed span
+    auto [first, last] = index.range(view.lowFreq, view.highFreq);
+    candidateCount = last - first;
+
+    // Without clusters every bookmark in the span gets a label. With them,
+    // a cluster gets labels for its bookmarks only if they fit in the rows.
+    const std::vector<BookmarkCluster>* level = NULL;
+    if (clusters) {
+        level = &clusters->level(CLUSTER_SPACING_EM * options.fontSize / view.freqToPixelRatio);
+    }
+    if (!level || level->empty()) {
+        for (size_t i = first; i < last; i++) {
+            placeLabel(schedule, bookmarks[i], view, options);
+        }
+    }
+    else {
+        // First cluster that reaches into the span
+        auto it = std::upper_bound(level->begin(), level->end(), first, [](size_t i, const BookmarkCluster& c) { return i < c.first; });
+        if (it != level->begin()) { it--; }
+        for (; it != level->end() && it->first < last; it++) {
+            if (it->first + it->count <= first) { continue; }
+            if (it->count > (uint32_t)options.rows + 1) {
+                placeCluster(*it, view, options);
+                continue;
+            }
+            size_t end = std::min<size_t>(last, it->first + it->count);
+            for (size_t i = std::max<size_t>(first, it->first); i < end; i++) {
+                placeLabel(schedule, bookmarks[i], view, options);
+            }
+        }
+    }
+    hitIndex.finish();
+}
+
+void OverlayLayout::placeLabel(const ScheduleEngine& schedule, const WaterfallBookmark& bm, const OverlayView& view, const OverlayOptions& options) {
+    double centerXpos = view.min.x + std::round((bm.frequency - view.lowFreq) * view.freqToPixelRatio);
+    ImVec2 nameSize = options.ticks ? ImVec2(0, options.fontSize) : bm.nameSize;
+
+    double bmMinX = 0.0;
+    double bmMaxX = 0.0;
+    if (options.centered) {
+        bmMinX = centerXpos - (nameSize.x / 2) - 5;
+        bmMaxX = centerXpos + (nameSize.x / 2) + 5;
+    } else {
+        bmMinX = centerXpos - 5;
+        bmMaxX = centerXpos + nameSize.x + 5;
+    }
+    int row = rowPacker.findRow(bmMinX);
+    if (row < 0) { return; }
+
+    ImVec2 rectMin, rectMax;
+
+    if (options.top) {
+        double bottomright = view.min.y + nameSize.y + (nameSize.y * row);
+        rectMin = ImVec2(bmMinX, view.min.y + (nameSize.y * row));
+        if (bottomright >= view.max.y) { return; }
+        rectMax = ImVec2(bmMaxX, bottomright);
+    } else {
+        double topleft = view.max.y - nameSize.y - (nameSize.y * row);
+        if (topleft <= view.min.y) { return; }
+        rectMin = ImVec2(bmMinX, topleft);
+        rectMax = ImVec2(bmMaxX, view.max.y - (nameSize.y * row));
+    }
+
+    rowPacker.occupy(row, bmMaxX);
+
+    LabelDrawCommand cmd;
+    cmd.id = bm.id;
+    cmd.rectMin = ImVec2(std::clamp<double>(rectMin.x, view.min.x, view.max.x), rectMin.y);
+    cmd.rectMax = ImVec2(std::clamp<double>(rectMax.x, view.min.x, view.max.x), rectMax.y);
+    hitIndex.add(row, cmd.rectMin.x, cmd.rectMin.y, cmd.rectMax.x, cmd.rectMax.y, bm.id);
+
+    // ImU32 bookmarkColor = IM_COL32(255, 255, 0, 255);
+    cmd.color = bm.color;
+    cmd.textColor = IM_COL32(0, 0, 0, 255);
+
+    if (!schedule.online(bm.id)) {
+        cmd.color = IM_COL32(128, 128, 128, 255);
+    }
+
+    if (!options.rectangle) {
+        cmd.textColor = cmd.color;
+    }
+
+    if (options.top) {
+        cmd.lineStart = ImVec2(centerXpos, view.min.y + (nameSize.y * (row + 1)));
+        cmd.lineEnd = ImVec2(centerXpos, view.max.y);
+        if (options.centered) {
+            cmd.textPos = ImVec2(centerXpos - (nameSize.x / 2), view.min.y + (nameSize.y * row));
+            cmd.drawText = ((centerXpos - (nameSize.x / 2)) >= view.min.x) && ((centerXpos + (nameSize.x / 2) <= view.max.x));
+        } else {
+            cmd.textPos = ImVec2(bmMinX + 6, view.min.y + (nameSize.y * row));
+            cmd.drawText = ((bmMinX + 6) >= view.min.x) && ((bmMinX + nameSize.x) <= view.max.x);
+        }
+    } else {
+        cmd.lineStart = ImVec2(centerXpos, view.min.y);
+        cmd.lineEnd = ImVec2(centerXpos, view.max.y - (nameSize.y * (row + 1)));
+        if (options.centered) {
+            cmd.textPos = ImVec2(centerXpos - (nameSize.x / 2), view.max.y - nameSize.y - (nameSize.y * row));
+        } else {
+            cmd.textPos = ImVec2(bmMinX + 6, view.max.y - nameSize.y - (nameSize.y * row));
+        }
+        cmd.drawText = true;
+    }
+
+    if (options.ticks) {
+        cmd.lineStart = ImVec2(centerXpos, rectMin.y);
+        cmd.lineEnd = ImVec2(centerXpos, rectMax.y);
+    }
+    cmd.drawText = cmd.drawText && options.text && !options.ticks;
+
+    size_t glyphs = cmd.drawText ? bm.nameLength : 0;
+    vertexCount += RECT_VERTICES + LINE_VERTICES + glyphs * GLYPH_VERTICES;
+    indexCount += RECT_INDICES + LINE_INDICES + glyphs * GLYPH_INDICES;
+    drawCmds.push_back(cmd);
+}
+
+void OverlayLayout::placeCluster(const BookmarkCluster& cluster, const OverlayView& view, const OverlayOptions& options) {
+    ClusterDrawCommand cmd;
+    snprintf(cmd.text, sizeof(cmd.text), "%u", cluster.count);
+    ImVec2 textSize = measureCount(options, cmd.text);
+
+    // Clusters reaching past the edges of the span stay on screen
+    double centerXpos = view.min.x + std::round((cluster.frequency - view.lowFreq) * view.freqToPixelRatio);
+    centerXpos = std::clamp<double>(centerXpos, view.min.x, view.max.x);
+    double minX = centerXpos - (textSize.x / 2) - 5;
+    double maxX = centerXpos + (textSize.x / 2) + 5;
+
+    int row = rowPacker.findRow(minX);
+    if (row < 0) { return; }
+
+    if (options.top) {
+        double bottom = view.min.y + textSize.y * (row + 1);
+        if (bottom >= view.max.y) { return; }
+        cmd.rectMin = ImVec2(minX, view.min.y + textSize.y * row);
+        cmd.rectMax = ImVec2(maxX, bottom);
+        cmd.lineStart = ImVec2(centerXpos, bottom);
+        cmd.lineEnd = ImVec2(centerXpos, view.max.y);
+    } else {
+        double top = view.max.y - textSize.y * (row + 1);
+        if (top <= view.min.y) { return; }
+        cmd.rectMin = ImVec2(minX, top);
+        cmd.rectMax = ImVec2(maxX, view.max.y - textSize.y * row);
+        cmd.lineStart = ImVec2(centerXpos, view.min.y);
+        cmd.lineEnd = ImVec2(centerXpos, top);
+    }
+    rowPacker.occupy(row, maxX);
+    cmd.textPos = ImVec2(centerXpos - (textSize.x / 2), cmd.rectMin.y);
+
+    // The bar is split in proportion to the bookmarks of each list color
+    float width = cmd.rectMax.x - cmd.rectMin.x;
+    uint32_t counted = 0;
+    cmd.segments = 0;
+    for (int i = 0; i < CLUSTER_COLORS && cluster.colorCounts[i]; i++) {
+        counted += cluster.colorCounts[i];
+        cmd.segmentColors[cmd.segments] = cluster.colors[i];
+        cmd.segmentEnds[cmd.segments++] = cmd.rectMin.x + width * counted / cluster.count;
+    }
+    if (counted < cluster.count) {
+        cmd.segmentColors[cmd.segments] = CLUSTER_OTHER_COLOR;
+        cmd.segmentEnds[cmd.segments++] = cmd.rectMax.x;
+    }
+
+    size_t glyphs = strlen(cmd.text);
+    vertexCount += cmd.segments * RECT_VERTICES + LINE_VERTICES + glyphs * GLYPH_VERTICES;
+    indexCount += cmd.segments * RECT_INDICES + LINE_INDICES + glyphs * GLYPH_INDICES;
+    clusterCmds.push_back(cmd);
+}
+
+size_t OverlayLayout::draw(ImDrawList* drawList, const BookmarkStore& store, bool rectangle, float offsetX) const {
+    // Grow the buffers once for the whole overlay instead of once per primitive
+    drawList->VtxBuffer.reserve(drawList->VtxBuffer.Size + (int)vertexCount);
+    drawList->IdxBuffer.reserve(drawList->IdxBuffer.Size + (int)indexCount);
+
+    auto moved = [offsetX](const ImVec2& p) { return ImVec2(p.x + offsetX, p.y); };
+    size_t calls = 0;
+    for (auto const& cmd : drawCmds) {
+        if (rectangle) {
+            drawList->AddRectFilled(moved(cmd.rectMin), moved(cmd.rectMax), cmd.color);
+            calls++;
+        }
+        drawList->AddLine(moved(cmd.lineStart), moved(cmd.lineEnd), cmd.color);
+        calls++;
+        if (cmd.drawText) {
+            drawList->AddText(moved(cmd.textPos), cmd.textColor, store.name(cmd.id));
+            calls++;
+        }
+    }
+    for (auto const& cmd : clusterCmds) {
+        float segmentStart = cmd.rectMin.x;
+        for (int i = 0; i < cmd.segments; i++) {
+            drawList->AddRectFilled(ImVec2(segmentStart + offsetX, cmd.rectMin.y), ImVec2(cmd.segmentEnds[i] + offsetX, cmd.rectMax.y), cmd.segmentColors[i]);
+            segmentStart = cmd.segmentEnds[i];
+            calls++;
+        }
+        drawList->AddLine(moved(cmd.lineStart), moved(cmd.lineEnd), cmd.segmentColors[0]);
+        drawList->AddText(moved(cmd.textPos), IM_COL32(0, 0, 0, 255), cmd.text);
+        calls += 2;
+    }
+    return calls;
+}
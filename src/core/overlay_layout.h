@@ -0,0 +1,137 @@
+#pragma once
+#include "bookmark_store.h"
+#include "frequency_index.h"
+#include "label_layout.h"
+#include "schedule.h"
+#include <imgui.h>
+#include <algorithm>
+#include <vector>
+
+class ClusterHierarchy;
+struct BookmarkCluster;
+
+// Entry of the waterfall overlay, referencing a bookmark of the store. It
+// carries everything the layout needs, so a layout never reads the store.
+struct WaterfallBookmark {
+    BookmarkId id;
+    ImU32 color;
+    double frequency;
+    ImVec2 nameSize; // See measureLabel(), again when the font changes
+    uint32_t nameLength; // For sizing the draw buffers
+};
+
+// Everything the overlay needs to draw one label, kept between frames so an
+// unchanged view can be redrawn without redoing the layout
+struct LabelDrawCommand {
+    BookmarkId id;
+    ImVec2 rectMin;
+    ImVec2 rectMax;
+    ImVec2 lineStart;
+    ImVec2 lineEnd;
+    ImVec2 textPos;
+    bool drawText;
+    ImU32 color;
+    ImU32 textColor;
+};
+
+// Marker standing in for a cluster of bookmarks too close to label one by
+// one: the bookmark count over a bar split by list color
+struct ClusterDrawCommand {
+    ImVec2 rectMin;
+    ImVec2 rectMax;
+    ImVec2 lineStart;
+    ImVec2 lineEnd;
+    ImVec2 textPos;
+    char text[12];
+    int segments;
+    ImU32 segmentColors[4];
+    float segmentEnds[4]; // Right edge of each color segment
+};
+
+// Part of the waterfall the overlay is drawn over
+struct OverlayView {
+    ImVec2 min;
+    ImVec2 max;
+    double lowFreq;
+    double highFreq;
+    double freqToPixelRatio;
+};
+
+struct OverlayOptions {
+    bool top; // Labels hang from the top edge instead of standing on the bottom one
+    int rows;
+    bool rectangle;
+    bool centered;
+    bool noClutter;
+    float fontSize;
+    // Widths of the digits cluster counts are written with, see measureDigits()
+    float digitWidths[10];
+    // Cheaper looks, for when drawing the overlay takes too long
+    bool text = true; // Without it, labels are only their line
+    bool ticks = false; // Bookmarks are short ticks a font size high, without measuring their names
+
+    bool operator==(const OverlayOptions& other) const {
+        return top == other.top && rows == other.rows && rectangle == other.rectangle && centered == other.centered
+            && noClutter == other.noClutter && fontSize == other.fontSize
+            && std::equal(digitWidths, digitWidths + 10, other.digitWidths)
+            && text == other.text && ticks == other.ticks;
+    }
+};
+
+// Size of a label as the overlay lays it out, the text width rounded up to
+// whole pixels. Reads the font, so only call it from the UI thread.
+ImVec2 measureLabel(const ImFont* font, float fontSize, const char* text);
+
+// Measures the digits of the cluster counts into the options, on the UI thread
+void measureDigits(OverlayOptions& options, const ImFont* font);
+
+// Pixels the labels laid out for `from` move right by when shown in `to`, or
+// NAN if `to` is not `from` panned (another size, position or zoom)
+float panOffset(const OverlayView& from, const OverlayView& to);
+
+// Lays out the labels of the waterfall bookmarks and keeps the result, so it
+// can be drawn and hit-tested until something it depends on changes. Laying
+// out reads neither ImGui nor the store, only what it is given, so it runs
+// without the GUI and off the UI thread.
+//
+// Every buffer is kept between layouts and only cleared, so once they have
+// grown to fit the view, neither layout() nor draw() allocate.
+class OverlayLayout {
+public:
+    // `bookmarks` must be sorted by frequency, have their labels measured
+    // with the options' font size and `index` must be built from them.
+    //
+    // With `clusters` built from the same bookmarks, bookmarks closer than a
+    // few characters' width are grouped and a group larger than the number of
+    // rows is drawn as one marker, so the work is bounded by the view width.
+    void layout(const ScheduleEngine& schedule, const std::vector<WaterfallBookmark>& bookmarks, const FrequencyIndex& index,
+                const OverlayView& view, const OverlayOptions& options, const ClusterHierarchy* clusters = NULL);
+
+    // Draws the labels moved right by `offsetX` pixels, for reusing a layout
+    // of a view that has since been panned. Names are read from `store`, which
+    // must hold the bookmarks the layout was made from. Returns the number of
+    // draw list calls made.
+    size_t draw(ImDrawList* drawList, const BookmarkStore& store, bool rectangle, float offsetX = 0.0f) const;
+
+    // Bookmark id of the label at the point, or LabelHitIndex::NONE. The
+    // point is in the coordinates of the view the layout was made for.
+    size_t find(float x, float y) const { return hitIndex.find(x, y); }
+
+    const std::vector<LabelDrawCommand>& commands() const { return drawCmds; }
+    const std::vector<ClusterDrawCommand>& clusterCommands() const { return clusterCmds; }
+
+    // Bookmarks in the displayed span, drawn or not
+    size_t candidates() const { return candidateCount; }
+
+private:
+    void placeLabel(const ScheduleEngine& schedule, const WaterfallBookmark& bm, const OverlayView& view, const OverlayOptions& options);
+    void placeCluster(const BookmarkCluster& cluster, const OverlayView& view, const OverlayOptions& options);
+
+    RowPacker rowPacker;
+    LabelHitIndex hitIndex;
+    std::vector<LabelDrawCommand> drawCmds;
+    std::vector<ClusterDrawCommand> clusterCmds;
+    size_t candidateCount = 0;
+    size_t vertexCount = 0; // Upper bounds of what draw() emits
+    size_t indexCount = 0;
+};
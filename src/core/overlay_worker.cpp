@@ -0,0 +1,60 @@
+#include "overlay_worker.h"
+
+OverlayWorker::OverlayWorker() {
+    workerThread = std::thread(&OverlayWorker::worker, this);
+}
+
+OverlayWorker::~OverlayWorker() {
+    {
+        std::lock_guard<std::mutex> lck(requestMtx);
+        stopWorker = true;
+    }
+    requestCnd.notify_all();
+    workerThread.join();
+}
+
+void OverlayWorker::request(std::shared_ptr<const OverlaySnapshot> snapshot, std::shared_ptr<const ScheduleEngine> schedule,
+                            const OverlayView& view, const OverlayOptions& options) {
+    {
+        std::lock_guard<std::mutex> lck(requestMtx);
+        pending.snapshot = std::move(snapshot);
+        pending.schedule = std::move(schedule);
+        pending.view = view;
+        pending.options = options;
+        pending.time = std::chrono::steady_clock::now();
+        hasPending = true;
+    }
+    requestCnd.notify_one();
+}
+
+bool OverlayWorker::acquire() {
+    if (!(readyFrame.load() & FRESH)) { return false; }
+    frontFrame = readyFrame.exchange(frontFrame) & ~FRESH;
+    hasFront = true;
+    return true;
+}
+
+void OverlayWorker::worker() {
+    Request req;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lck(requestMtx);
+            requestCnd.wait(lck, [this]() { return hasPending || stopWorker; });
+            if (stopWorker) { return; }
+            req = std::move(pending);
+            hasPending = false;
+        }
+
+        OverlayFrame& frame = frames[backFrame];
+        const OverlaySnapshot& snap = *req.snapshot;
+        frame.layout.layout(*req.schedule, snap.bookmarks, snap.index, req.view, req.options, snap.useClusters ? &snap.clusters : NULL);
+        frame.snapshot = std::move(req.snapshot);
+        frame.schedule = std::move(req.schedule);
+        frame.view = req.view;
+        frame.options = req.options;
+        frame.latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - req.time).count();
+
+        // Publish it and take back whichever frame was waiting, picked up or not
+        backFrame = readyFrame.exchange(backFrame | FRESH) & ~FRESH;
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "overlay_layout.h"
+#include "bookmark_clusters.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// The shown bookmarks a layout is made from, copied when they change and
+// never modified once handed to the worker. The waterfall bookmarks carry
+// their frequency and measured label, so no copy of the store is held: edits
+// made meanwhile on the UI thread don't have to copy its columns.
+struct OverlaySnapshot {
+    std::vector<WaterfallBookmark> bookmarks;
+    FrequencyIndex index;
+    ClusterHierarchy clusters;
+    bool useClusters = false;
+};
+
+// A finished layout, along with what it was made from
+struct OverlayFrame {
+    OverlayLayout layout;
+    std::shared_ptr<const OverlaySnapshot> snapshot;
+    std::shared_ptr<const ScheduleEngine> schedule;
+    OverlayView view;
+    OverlayOptions options;
+    double latency = 0.0; // From request() to being ready, in ms
+};
+
+// Lays out the overlay on a thread of its own. The UI thread hands over a
+// snapshot and a view and picks the finished layout up on a later frame.
+//
+// Frames are triple buffered: the worker fills one, one waits to be picked up
+// and the UI thread draws the third. Handing a frame over either way is a
+// single atomic exchange, so neither side waits for the other.
+class OverlayWorker {
+public:
+    OverlayWorker();
+    ~OverlayWorker();
+
+    // Replaces the previous request if the worker hasn't started on it yet
+    void request(std::shared_ptr<const OverlaySnapshot> snapshot, std::shared_ptr<const ScheduleEngine> schedule,
+                 const OverlayView& view, const OverlayOptions& options);
+
+    // Makes the newest finished layout the front one. Returns true if there
+    // was one. Only the front frame may be read, until the next call.
+    bool acquire();
+
+    // NULL until a layout has been acquired
+    const OverlayFrame* front() const { return hasFront ? &frames[frontFrame] : NULL; }
+
+private:
+    struct Request {
+        std::shared_ptr<const OverlaySnapshot> snapshot;
+        std::shared_ptr<const ScheduleEngine> schedule;
+        OverlayView view;
+        OverlayOptions options;
+        std::chrono::steady_clock::time_point time;
+    };
+
+    // Set in the shared slot when it holds a frame not picked up yet
+    static constexpr int FRESH = 4;
+
+    void worker();
+
+    OverlayFrame frames[3];
+    int frontFrame = 0; // UI thread only
+    int backFrame = 1; // Worker thread only
+    std::atomic<int> readyFrame { 2 };
+    bool hasFront = false;
+
+    std::thread workerThread;
+    std::mutex requestMtx;
+    std::condition_variable requestCnd;
+    Request pending;
+    bool hasPending = false;
+    bool stopWorker = false;
+};
@@ -0,0 +1,164 @@
+#include "schedule.h"
+#include <algorithm>
+
+namespace {
+    constexpr int MINUTES_PER_DAY = 1440;
+
+    // The Unix epoch fell on a Thursday
+    constexpr int EPOCH_WEEK_DAY = 4;
+
+    // First minute of the day whose HHMM value is at least `time`
+    int64_t firstMinuteFrom(int time) {
+        if (time <= 0) { return 0; }
+        int hours = time / 100;
+        int minutes = time % 100;
+        int64_t minute = (minutes >= 60) ? (hours + 1) * 60 : hours * 60 + minutes;
+        return std::min<int64_t>(minute, MINUTES_PER_DAY);
+    }
+}
+
+bool timeValid(int time) {
+    // Check HHMM time validity.
+    int hours = time / 100;
+    int minutes = time % 100;
+
+    return (hours >= 0 && hours <= 23 && minutes >= 0 && minutes <= 59);
+}
+
+bool bookmarkOnline(int startTime, int endTime, uint8_t days, int now, int weekDay) {
+    if (!((days >> weekDay) & 1)) {
+        return false;
+    }
+
+    if (startTime == 0 && endTime == 0) {
+        return true;
+    } else if (startTime < endTime) {
+        return (startTime <= now) && (now < endTime);
+    } else if (startTime > endTime) {
+        return ((startTime <= now) && (now <= 2359))
+            || ((startTime >= 0) && (now <= endTime));
+    } else {
+        return false; // When start and end times are equal (except 0000).
+    }
+}
+
+bool bookmarkOnlineAt(int startTime, int endTime, uint8_t days, int64_t epochMinute) {
+    int64_t day = epochMinute / MINUTES_PER_DAY;
+    int minuteOfDay = epochMinute % MINUTES_PER_DAY;
+    int weekDay = (day + EPOCH_WEEK_DAY) % 7;
+    int now = (minuteOfDay / 60) * 100 + (minuteOfDay % 60);
+    return bookmarkOnline(startTime, endTime, days, now, weekDay);
+}
+
+int64_t nextScheduleTransition(int startTime, int endTime, uint8_t days, int64_t epochMinute) {
+    // The state can only change at midnight (week day), when the start time is
+    // reached, or when the end time is reached or passed depending on the case
+    // above. Checking those minutes over the next eight days covers a full week.
+    int64_t offsets[4] = {
+        0,
+        firstMinuteFrom(startTime),
+        firstMinuteFrom(endTime),
+        firstMinuteFrom(endTime + 1)
+    };
+    std::sort(offsets, offsets + 4);
+
+    bool current = bookmarkOnlineAt(startTime, endTime, days, epochMinute);
+    int64_t dayStart = epochMinute - (epochMinute % MINUTES_PER_DAY);
+    for (int d = 0; d <= 7; d++) {
+        for (int64_t offset : offsets) {
+            int64_t minute = dayStart + d * MINUTES_PER_DAY + offset;
+            if (minute <= epochMinute) { continue; }
+            if (bookmarkOnlineAt(startTime, endTime, days, minute) != current) { return minute; }
+        }
+    }
+    return NEVER;
+}
+
+bool ScheduleEngine::later(const Transition& a, const Transition& b) {
+    // Orders the heap so the earliest transition is at the front
+    return a.minute > b.minute;
+}
+
+void ScheduleEngine::update(const BookmarkStore& store, int64_t epochMinute) {
+    if (allPending) {
+        rebuild(store, epochMinute);
+        return;
+    }
+
+    if (onlineStates.size() < store.capacity()) {
+        onlineStates.resize(store.capacity(), 0);
+        versions.resize(store.capacity(), 0);
+    }
+
+    for (BookmarkId id : pending) {
+        if (store.valid(id)) { evaluate(store, id, epochMinute); }
+        else if (onlineStates[id]) {
+            onlineStates[id] = 0;
+            changes++;
+        }
+    }
+    pending.clear();
+
+    while (!heap.empty() && heap.front().minute <= epochMinute) {
+        Transition t = heap.front();
+        std::pop_heap(heap.begin(), heap.end(), later);
+        heap.pop_back();
+        if (t.version != versions[t.id] || !store.valid(t.id)) { continue; }
+        evaluate(store, t.id, epochMinute);
+    }
+
+    // Drop stale entries left behind by edits once they dominate the heap
+    if (heap.size() > 2 * store.size() + 1024) {
+        heap.erase(std::remove_if(heap.begin(), heap.end(), [this](const Transition& t) {
+            return t.version != versions[t.id];
+        }), heap.end());
+        std::make_heap(heap.begin(), heap.end(), later);
+    }
+}
+
+void ScheduleEngine::invalidate(BookmarkId id) {
+    if (id < versions.size()) { versions[id]++; }
+    pending.push_back(id);
+}
+
+void ScheduleEngine::invalidateAll() {
+    allPending = true;
+}
+
+ScheduleEngine ScheduleEngine::statesCopy() const {
+    ScheduleEngine copy;
+    copy.onlineStates = onlineStates;
+    copy.changes = changes;
+    copy.allPending = false;
+    return copy;
+}
+
+void ScheduleEngine::evaluate(const BookmarkStore& store, BookmarkId id, int64_t epochMinute) {
+    int startTime = store.startTime(id);
+    int endTime = store.endTime(id);
+    uint8_t days = store.days(id);
+
+    uint8_t state = bookmarkOnlineAt(startTime, endTime, days, epochMinute);
+    if (state != onlineStates[id]) {
+        onlineStates[id] = state;
+        changes++;
+    }
+
+    int64_t next = nextScheduleTransition(startTime, endTime, days, epochMinute);
+    if (next == NEVER) { return; }
+    heap.push_back({ next, id, versions[id] });
+    std::push_heap(heap.begin(), heap.end(), later);
+}
+
+void ScheduleEngine::rebuild(const BookmarkStore& store, int64_t epochMinute) {
+    allPending = false;
+    pending.clear();
+    heap.clear();
+    onlineStates.assign(store.capacity(), 0);
+    versions.resize(store.capacity(), 0);
+    for (auto& version : versions) { version++; }
+    for (BookmarkId id = 0; id < store.capacity(); id++) {
+        if (store.valid(id)) { evaluate(store, id, epochMinute); }
+    }
+    changes++;
+}
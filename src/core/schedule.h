@@ -0,0 +1,59 @@
+#pragma once
+#include "bookmark_store.h"
+#include <vector>
+#include <cstdint>
+
+constexpr int64_t NEVER = INT64_MAX;
+
+// Check HHMM time validity
+bool timeValid(int time);
+
+// Whether a bookmark is on air at `now` (HHMM, UTC) on the given week day (0 = Sunday)
+bool bookmarkOnline(int startTime, int endTime, uint8_t days, int now, int weekDay);
+
+// Same as above, for a UTC time given in minutes since the Unix epoch
+bool bookmarkOnlineAt(int startTime, int endTime, uint8_t days, int64_t epochMinute);
+
+// First minute after `epochMinute` at which the on-air state of the bookmark
+// changes, or NEVER if it stays the same forever
+int64_t nextScheduleTransition(int startTime, int endTime, uint8_t days, int64_t epochMinute);
+
+// Keeps the on-air state of every bookmark of a store. Each bookmark is
+// evaluated once and then only again when its next transition is due, found
+// through a min-heap of transition times, so reading the state is a lookup.
+class ScheduleEngine {
+public:
+    // Brings the state up to date for the given time. Cheap when no transition is due.
+    void update(const BookmarkStore& store, int64_t epochMinute);
+
+    // Must be called whenever a bookmark is added, changed or removed
+    void invalidate(BookmarkId id);
+    void invalidateAll();
+
+    bool online(BookmarkId id) const { return id < onlineStates.size() && onlineStates[id]; }
+
+    // Changes whenever the state of any bookmark changes
+    uint64_t generation() const { return changes; }
+
+    // Copy of the current states only, without the transitions, for reading
+    // them on another thread. It must not be updated.
+    ScheduleEngine statesCopy() const;
+
+private:
+    struct Transition {
+        int64_t minute;
+        BookmarkId id;
+        uint32_t version;
+    };
+
+    static bool later(const Transition& a, const Transition& b);
+    void evaluate(const BookmarkStore& store, BookmarkId id, int64_t epochMinute);
+    void rebuild(const BookmarkStore& store, int64_t epochMinute);
+
+    std::vector<uint8_t> onlineStates;
+    std::vector<uint32_t> versions; // Heap entries of an older version are stale
+    std::vector<Transition> heap;
+    std::vector<BookmarkId> pending;
+    bool allPending = true;
+    uint64_t changes = 0;
+};
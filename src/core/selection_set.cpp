@@ -0,0 +1,46 @@
+#include "selection_set.h"
+
+void SelectionSet::add(BookmarkId id) {
+    if (contains(id)) { return; }
+    if (id >= marks.size()) {
+        marks.resize(id + 1, Mark { 0, 0 });
+    }
+    marks[id].generation = generation;
+    marks[id].position = members.size();
+    members.push_back(id);
+}
+
+void SelectionSet::remove(BookmarkId id) {
+    if (!contains(id)) { return; }
+
+    // Move the last member into the hole
+    uint32_t pos = marks[id].position;
+    BookmarkId last = members.back();
+    members[pos] = last;
+    marks[last].position = pos;
+    members.pop_back();
+    marks[id].generation = 0;
+    if (anchor == id) { anchor = INVALID_BOOKMARK; }
+}
+
+void SelectionSet::toggle(BookmarkId id) {
+    if (contains(id)) {
+        remove(id);
+    }
+    else {
+        add(id);
+    }
+}
+
+void SelectionSet::clear() {
+    members.clear();
+    anchor = INVALID_BOOKMARK;
+    generation++;
+
+    // Marks of the old generations could be mistaken for current ones once
+    // the counter wraps around
+    if (generation == 0) {
+        marks.assign(marks.size(), Mark { 0, 0 });
+        generation = 1;
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "bookmark_store.h"
+#include <vector>
+#include <cstdint>
+
+// Set of selected bookmarks, kept up to date by the edits instead of being
+// rebuilt from the list each frame. Membership is a per-id mark compared with
+// the current generation, so clearing the set only bumps the generation.
+// The members are also kept in a dense vector, in the order they were
+// selected, which makes counting and iterating them independent of the
+// number of bookmarks.
+class SelectionSet {
+public:
+    bool contains(BookmarkId id) const { return id < marks.size() && marks[id].generation == generation; }
+
+    void add(BookmarkId id);
+    void remove(BookmarkId id);
+    void toggle(BookmarkId id);
+    void clear();
+
+    size_t size() const { return members.size(); }
+    bool empty() const { return members.empty(); }
+    const std::vector<BookmarkId>& ids() const { return members; }
+
+    // Start of the next shift-click range, INVALID_BOOKMARK if none
+    BookmarkId anchor = INVALID_BOOKMARK;
+
+private:
+    struct Mark {
+        uint32_t generation;
+        uint32_t position; // Index in members
+    };
+
+    std::vector<Mark> marks;
+    std::vector<BookmarkId> members;
+    uint32_t generation = 1;
+};
@@ -0,0 +1,172 @@
+#include "sorted_bookmarks.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    uint64_t namePrefix(const char* name) {
+        uint64_t prefix = 0;
+        int i = 0;
+        for (; i < 8 && name[i]; i++) {
+            prefix = (prefix << 8) | (uint8_t)name[i];
+        }
+        return prefix << (8 * (8 - i));
+    }
+
+    template <class T>
+    int compare(T a, T b) {
+        return (a < b) ? -1 : ((b < a) ? 1 : 0);
+    }
+}
+
+class SortedBookmarks::Less {
+public:
+    Less(const SortedBookmarks& sorted, const BookmarkStore& store) : sorted(sorted), store(store) {}
+
+    bool operator()(BookmarkId a, BookmarkId b) const {
+        const Keys& ka = sorted.keys[a];
+        const Keys& kb = sorted.keys[b];
+        for (auto const& spec : sorted.specs) {
+            int cmp = 0;
+            switch (spec.key) {
+            case SORT_FREQUENCY:
+                cmp = compare(ka.frequency, kb.frequency);
+                break;
+            case SORT_NAME:
+                cmp = compare(ka.namePrefix, kb.namePrefix);
+                // Equal prefixes of 8 bytes, the rest decides
+                if (cmp == 0 && (ka.namePrefix & 0xFF)) {
+                    cmp = strcmp(store.name(a), store.name(b));
+                }
+                break;
+            case SORT_MODE:
+                cmp = compare(ka.mode, kb.mode);
+                break;
+            case SORT_START_TIME:
+                cmp = compare(ka.startTime, kb.startTime);
+                break;
+            case SORT_ONLINE:
+                cmp = compare(ka.online, kb.online);
+                break;
+            case SORT_LIST:
+                cmp = compare(ka.listRank, kb.listRank);
+                break;
+            }
+            if (cmp != 0) { return spec.descending ? cmp > 0 : cmp < 0; }
+        }
+        // Ids make the order total, which the binary searches rely on
+        return a < b;
+    }
+
+private:
+    const SortedBookmarks& sorted;
+    const BookmarkStore& store;
+};
+
+void SortedBookmarks::setSpecs(const std::vector<BookmarkSortSpec>& specs) {
+    this->specs = specs;
+    dirty = true;
+}
+
+void SortedBookmarks::assign(std::vector<BookmarkId> ids) {
+    clear();
+    order = std::move(ids);
+    for (BookmarkId id : order) {
+        if (id >= keys.size()) { keys.resize(id + 1); }
+        keys[id].present = true;
+    }
+}
+
+void SortedBookmarks::clear() {
+    for (BookmarkId id : order) { keys[id].present = false; }
+    order.clear();
+    dirty = true;
+}
+
+bool SortedBookmarks::refresh(const BookmarkStore& store, const ScheduleEngine& schedule) {
+    if (!dirty && !(usesKey(SORT_ONLINE) && schedule.generation() != scheduleGeneration)) {
+        return false;
+    }
+    rankLists(store);
+    for (BookmarkId id : order) {
+        computeKeys(store, schedule, id);
+    }
+    std::sort(order.begin(), order.end(), Less(*this, store));
+    scheduleGeneration = schedule.generation();
+    dirty = false;
+    return true;
+}
+
+void SortedBookmarks::insert(const BookmarkStore& store, const ScheduleEngine& schedule, BookmarkId id) {
+    if (contains(id)) { return; }
+    if (id >= keys.size()) { keys.resize(id + 1); }
+    keys[id].present = true;
+    if (dirty) {
+        order.push_back(id);
+        return;
+    }
+    computeKeys(store, schedule, id);
+    order.insert(std::upper_bound(order.begin(), order.end(), id, Less(*this, store)), id);
+}
+
+void SortedBookmarks::insert(const BookmarkStore& store, const ScheduleEngine& schedule, const std::vector<BookmarkId>& ids) {
+    size_t oldCount = order.size();
+    for (BookmarkId id : ids) {
+        if (contains(id)) { continue; }
+        if (id >= keys.size()) { keys.resize(id + 1); }
+        keys[id].present = true;
+        if (!dirty) { computeKeys(store, schedule, id); }
+        order.push_back(id);
+    }
+    if (dirty) { return; }
+
+    // Sort only the new entries and merge them into the existing order
+    Less less(*this, store);
+    std::sort(order.begin() + oldCount, order.end(), less);
+    std::inplace_merge(order.begin(), order.begin() + oldCount, order.end(), less);
+}
+
+void SortedBookmarks::erase(const BookmarkStore& store, BookmarkId id) {
+    if (!contains(id)) { return; }
+    keys[id].present = false;
+    if (dirty) {
+        order.erase(std::find(order.begin(), order.end(), id));
+        return;
+    }
+    auto it = std::lower_bound(order.begin(), order.end(), id, Less(*this, store));
+    if (it != order.end() && *it == id) {
+        order.erase(it);
+    }
+    else {
+        // Keys that went stale without markDirty(), fall back to a scan
+        order.erase(std::find(order.begin(), order.end(), id));
+    }
+}
+
+void SortedBookmarks::computeKeys(const BookmarkStore& store, const ScheduleEngine& schedule, BookmarkId id) {
+    Keys& k = keys[id];
+    k.frequency = store.frequency(id);
+    k.namePrefix = namePrefix(store.name(id));
+    k.mode = store.mode(id);
+    k.startTime = store.startTime(id);
+    ListId list = store.listOf(id);
+    k.listRank = (list < listRanks.size()) ? listRanks[list] : UINT16_MAX;
+    k.online = schedule.online(id);
+}
+
+void SortedBookmarks::rankLists(const BookmarkStore& store) {
+    std::vector<ListId> lists;
+    for (ListId list = 0; list < store.listCapacity(); list++) {
+        if (store.getList(list).alive) { lists.push_back(list); }
+    }
+    std::sort(lists.begin(), lists.end(), [&store](ListId a, ListId b) {
+        return store.getList(a).name < store.getList(b).name;
+    });
+    listRanks.assign(store.listCapacity(), UINT16_MAX);
+    for (size_t i = 0; i < lists.size(); i++) {
+        listRanks[lists[i]] = i;
+    }
+}
+
+bool SortedBookmarks::usesKey(BookmarkSortKey key) const {
+    return std::any_of(specs.begin(), specs.end(), [key](const BookmarkSortSpec& spec) { return spec.key == key; });
+}
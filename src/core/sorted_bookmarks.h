@@ -0,0 +1,74 @@
+#pragma once
+#include "bookmark_store.h"
+#include "schedule.h"
+#include <vector>
+#include <cstdint>
+
+enum BookmarkSortKey {
+    SORT_FREQUENCY,
+    SORT_NAME,
+    SORT_MODE,
+    SORT_START_TIME,
+    SORT_ONLINE,
+    SORT_LIST
+};
+
+struct BookmarkSortSpec {
+    BookmarkSortKey key;
+    bool descending;
+};
+
+// Bookmarks of the table in the order given by a list of sort specs, the
+// first spec deciding first. Sort keys are computed once per bookmark, and
+// single edits are applied with a binary search into the existing order
+// instead of sorting again, so only changing the specs costs a full sort.
+//
+// Names are compared through a cached prefix and only read from the store for
+// ties, so a bookmark must be erased before its name changes in the store.
+class SortedBookmarks {
+public:
+    void setSpecs(const std::vector<BookmarkSortSpec>& specs);
+
+    // Replaces the bookmarks, which get sorted on the next refresh()
+    void assign(std::vector<BookmarkId> ids);
+    void clear();
+
+    // For changes that affect every key, such as a list being renamed
+    void markDirty() { dirty = true; }
+
+    // Sorts everything again if needed: after one of the calls above or, when
+    // sorting by on air state, after the schedule changed. Returns true if it did.
+    bool refresh(const BookmarkStore& store, const ScheduleEngine& schedule);
+
+    void insert(const BookmarkStore& store, const ScheduleEngine& schedule, BookmarkId id);
+    void insert(const BookmarkStore& store, const ScheduleEngine& schedule, const std::vector<BookmarkId>& ids);
+    void erase(const BookmarkStore& store, BookmarkId id);
+
+    const std::vector<BookmarkId>& ids() const { return order; }
+    size_t size() const { return order.size(); }
+    bool contains(BookmarkId id) const { return id < keys.size() && keys[id].present; }
+
+private:
+    struct Keys {
+        double frequency;
+        uint64_t namePrefix; // First bytes of the name, big endian so they compare like strcmp
+        int32_t mode;
+        int32_t startTime;
+        uint16_t listRank; // Position of the list when ordered by name
+        bool online;
+        bool present;
+    };
+
+    class Less;
+
+    void computeKeys(const BookmarkStore& store, const ScheduleEngine& schedule, BookmarkId id);
+    void rankLists(const BookmarkStore& store);
+    bool usesKey(BookmarkSortKey key) const;
+
+    std::vector<BookmarkSortSpec> specs = { { SORT_NAME, false } };
+    std::vector<BookmarkId> order;
+    std::vector<Keys> keys;
+    std::vector<uint16_t> listRanks;
+    uint64_t scheduleGeneration = 0;
+    bool dirty = true;
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+// ASCII case folding for the case-insensitive matches of the search and the
+// overlay filter. Other bytes, UTF-8 included, are matched as they are.
+
+inline uint8_t fold(char c) {
+    return (c >= 'A' && c <= 'Z') ? (uint8_t)(c - 'A' + 'a') : (uint8_t)c;
+}
+
+inline std::string foldText(const std::string& text) {
+    std::string folded(text.size(), '\0');
+    for (size_t i = 0; i < text.size(); i++) { folded[i] = (char)fold(text[i]); }
+    return folded;
+}
+
+// Whether `haystack` contains `needle`, which must already be folded
+inline bool containsFolded(const char* haystack, const std::string& needle) {
+    if (needle.empty()) { return true; }
+    uint8_t first = (uint8_t)needle[0];
+    for (const char* h = haystack; *h; h++) {
+        if (fold(*h) != first) { continue; }
+        size_t i = 1;
+        while (i < needle.size() && h[i] && fold(h[i]) == (uint8_t)needle[i]) { i++; }
+        if (i == needle.size()) { return true; }
+        if (!h[i]) { return false; }
+    }
+    return false;
+}
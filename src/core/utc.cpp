@@ -0,0 +1,64 @@
+/**
+ * @file utc.h
+ * @author your Otto Pattemore https://github.com/OttoPattemore/shortwave-station-list-sdrpp/
+ * @brief 
+ * @version 0.1
+ * @date 2022-08-02
+ * 
+ * @copyright Copyright (c) Otto Pattemore 2022
+ * 
+ */
+#include "utc.h"
+#include <chrono>
+#include <ctime>
+
+namespace {
+    const SystemClock systemClock;
+    std::atomic<const Clock*> source(&systemClock);
+}
+
+int64_t UTCTime::epochMinute() const
+{
+    // Floor division so times before the epoch stay consistent
+    return (epochSeconds >= 0) ? epochSeconds / 60 : -((59 - epochSeconds) / 60);
+}
+
+int64_t SystemClock::now() const
+{
+    using namespace std::chrono;
+    return duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+}
+
+namespace utc {
+    void setClock(const Clock* clock)
+    {
+        source.store(clock ? clock : &systemClock);
+    }
+
+    UTCTime fromEpoch(int64_t epochSeconds)
+    {
+        // std::gmtime returns shared static storage, use the reentrant versions
+        std::time_t t = (std::time_t)epochSeconds;
+        std::tm tm = {};
+#ifdef _WIN32
+        gmtime_s(&tm, &t);
+#else
+        gmtime_r(&t, &tm);
+#endif
+        UTCTime time;
+        time.epochSeconds = epochSeconds;
+        time.year = tm.tm_year + 1900;
+        time.month = tm.tm_mon + 1;
+        time.day = tm.tm_mday;
+        time.hour = tm.tm_hour;
+        time.minute = tm.tm_min;
+        time.second = tm.tm_sec;
+        time.weekDay = tm.tm_wday;
+        return time;
+    }
+
+    UTCTime now()
+    {
+        return fromEpoch(source.load()->now());
+    }
+}
@@ -0,0 +1,66 @@
+/**
+ * @file utc.h
+ * @author your Otto Pattemore https://github.com/OttoPattemore/shortwave-station-list-sdrpp/
+ * @brief 
+ * @version 0.1
+ * @date 2022-08-02
+ * 
+ * @copyright Copyright (c) Otto Pattemore 2022
+ * 
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Broken down UTC time, taken from a single clock reading
+struct UTCTime {
+    int64_t epochSeconds = 0;
+    int year = 1970;
+    int month = 1; // 1 - 12
+    int day = 1;   // 1 - 31
+    int hour = 0;
+    int minute = 0;
+    int second = 0;
+    int weekDay = 4; // 0 = Sunday
+
+    // HHMM, as used by bookmark schedules
+    int hhmm() const { return hour * 100 + minute; }
+    int64_t epochMinute() const;
+};
+
+// Source of the current time in seconds since the Unix epoch
+class Clock {
+public:
+    virtual ~Clock() {}
+    virtual int64_t now() const = 0;
+};
+
+class SystemClock : public Clock {
+public:
+    int64_t now() const override;
+};
+
+// Clock that only moves when told to, for tests and replaying recordings
+class FakeClock : public Clock {
+public:
+    FakeClock(int64_t epochSeconds = 0) : seconds(epochSeconds) {}
+    int64_t now() const override { return seconds.load(std::memory_order_relaxed); }
+    void set(int64_t epochSeconds) { seconds.store(epochSeconds, std::memory_order_relaxed); }
+    void advance(int64_t delta) { seconds.fetch_add(delta, std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> seconds;
+};
+
+// Process wide clock service. Every function is safe to call from any thread.
+namespace utc {
+    // Replace the time source, nullptr restores the system clock.
+    // The clock must outlive its use.
+    void setClock(const Clock* clock);
+
+    // Convert seconds since the epoch, without touching shared state
+    UTCTime fromEpoch(int64_t epochSeconds);
+
+    // Read the clock now
+    UTCTime now();
+}
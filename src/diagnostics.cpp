@@ -0,0 +1,220 @@
+#include "diagnostics.h"
+
+#ifdef BOOKMARK_MANAGER_DIAGNOSTICS
+#include <imgui.h>
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <vector>
+
+// Allocations are counted by replacing operator new for the plugin. The build
+// binds the plugin's calls to these (see CMakeLists.txt) while the rest of the
+// application keeps its own.
+namespace {
+    thread_local uint64_t allocations = 0;
+}
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* ptr = std::malloc(size ? size : 1)) { return ptr; }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace diag {
+    namespace {
+        // Number of samples kept per series
+        constexpr size_t HISTORY = 1024;
+
+        const char* TIMER_NAMES[_TIMER_COUNT] = {
+            "fftRedraw",
+            "fftInput",
+            "menuHandler",
+            "refreshWaterfallBookmarks",
+            "loadByName",
+            "commitEdits",
+            "layoutLatency",
+            "persistenceStall",
+            "journalWrite",
+            "databaseWrite"
+        };
+
+        const char* COUNTER_NAMES[_COUNTER_COUNT] = {
+            "visibleLabels",
+            "skippedLabels",
+            "drawCalls",
+            "allocations",
+            "renderAllocations",
+            "staleFrames",
+            "syncLayouts",
+            "detailChanges",
+            "persistenceQueued",
+            "journalKB"
+        };
+
+        class Series {
+        public:
+            void push(float val) {
+                if (samples.size() < HISTORY) {
+                    samples.push_back(val);
+                }
+                else {
+                    samples[next] = val;
+                }
+                next = (next + 1) % HISTORY;
+            }
+
+            struct Summary {
+                float p50, p99, max;
+                size_t count;
+            };
+
+            Summary summarize() const {
+                Summary sum = { 0.0f, 0.0f, 0.0f, samples.size() };
+                if (samples.empty()) { return sum; }
+                std::vector<float> sorted = samples;
+                std::sort(sorted.begin(), sorted.end());
+                sum.p50 = sorted[(sorted.size() - 1) / 2];
+                sum.p99 = sorted[(sorted.size() - 1) * 99 / 100];
+                sum.max = sorted.back();
+                return sum;
+            }
+
+            // Samples from oldest to newest, for plotting
+            std::vector<float> ordered() const {
+                if (samples.size() < HISTORY) { return samples; }
+                std::vector<float> out(samples.begin() + next, samples.end());
+                out.insert(out.end(), samples.begin(), samples.begin() + next);
+                return out;
+            }
+
+            void clear() {
+                samples.clear();
+                next = 0;
+            }
+
+        private:
+            std::vector<float> samples;
+            size_t next = 0;
+        };
+
+        // Only ever touched from the UI thread
+        std::array<Series, _TIMER_COUNT> timers;
+        std::array<Series, _COUNTER_COUNT> counters;
+        std::array<uint64_t, _COUNTER_COUNT> frameCounts = {};
+        int frame = -1;
+        uint64_t frameAllocations = 0;
+
+        // Closes the counters of the previous frame once a new one starts
+        void rollFrame() {
+            int current = ImGui::GetFrameCount();
+            if (current == frame) { return; }
+            if (frame >= 0) {
+                frameCounts[COUNTER_ALLOCATIONS] = allocations - frameAllocations;
+                for (int i = 0; i < _COUNTER_COUNT; i++) {
+                    counters[i].push((float)frameCounts[i]);
+                }
+            }
+            frameCounts.fill(0);
+            frameAllocations = allocations;
+            frame = current;
+        }
+
+        void drawRow(const char* name, const Series& series, const char* fmt) {
+            Series::Summary sum = series.summarize();
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::TextUnformatted(name);
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text(fmt, sum.p50);
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text(fmt, sum.p99);
+            ImGui::TableSetColumnIndex(3);
+            ImGui::Text(fmt, sum.max);
+        }
+    }
+
+    void record(Timer timer, double ms) {
+        rollFrame();
+        timers[timer].push((float)ms);
+    }
+
+    void count(Counter counter, uint64_t n) {
+        rollFrame();
+        frameCounts[counter] += n;
+    }
+
+    uint64_t allocationCount() {
+        return allocations;
+    }
+
+    void draw(const std::string& id) {
+        rollFrame();
+        if (ImGui::BeginTable(("##_freq_mgr_diag_" + id).c_str(), 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+            ImGui::TableSetupColumn("Metric", ImGuiTableColumnFlags_WidthStretch);
+            ImGui::TableSetupColumn("p50");
+            ImGui::TableSetupColumn("p99");
+            ImGui::TableSetupColumn("max");
+            ImGui::TableHeadersRow();
+            for (int i = 0; i < _TIMER_COUNT; i++) {
+                drawRow(TIMER_NAMES[i], timers[i], "%.3f ms");
+            }
+            for (int i = 0; i < _COUNTER_COUNT; i++) {
+                drawRow(COUNTER_NAMES[i], counters[i], "%.0f");
+            }
+            ImGui::EndTable();
+        }
+
+        std::vector<float> redraw = timers[TIMER_FFT_REDRAW].ordered();
+        ImGui::PlotLines(("##_freq_mgr_diag_plot_" + id).c_str(), redraw.data(), redraw.size(), 0, "fftRedraw (ms)", 0.0f, 3.4e38f, ImVec2(ImGui::GetContentRegionAvail().x, 60));
+
+        if (ImGui::Button(("Clear##_freq_mgr_diag_clr_" + id).c_str())) {
+            for (auto& series : timers) { series.clear(); }
+            for (auto& series : counters) { series.clear(); }
+        }
+    }
+
+    bool exportCsv(const std::string& path, std::string& error) {
+        std::ofstream fs(path);
+        if (!fs) {
+            error = "Could not open " + path;
+            return false;
+        }
+        fs << "metric,unit,samples,p50,p99,max\n";
+        for (int i = 0; i < _TIMER_COUNT; i++) {
+            Series::Summary sum = timers[i].summarize();
+            fs << TIMER_NAMES[i] << ",ms," << sum.count << ',' << sum.p50 << ',' << sum.p99 << ',' << sum.max << '\n';
+        }
+        for (int i = 0; i < _COUNTER_COUNT; i++) {
+            Series::Summary sum = counters[i].summarize();
+            fs << COUNTER_NAMES[i] << ",per frame," << sum.count << ',' << sum.p50 << ',' << sum.p99 << ',' << sum.max << '\n';
+        }
+        if (!fs) {
+            error = "Could not write " + path;
+            return false;
+        }
+        return true;
+    }
+}
+#endif
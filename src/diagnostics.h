@@ -0,0 +1,90 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Per-frame instrumentation of the plugin. It is only compiled in with the
+// OPT_BOOKMARK_MANAGER_DIAGNOSTICS CMake option, otherwise the DIAG_ macros
+// expand to nothing.
+//
+// Timers keep one sample per call, counters one sample per frame. The last
+// samples of each are kept to show their p50, p99 and max.
+namespace diag {
+    enum Timer {
+        TIMER_FFT_REDRAW,
+        TIMER_FFT_INPUT,
+        TIMER_MENU,
+        TIMER_REFRESH_WATERFALL,
+        TIMER_LOAD_BY_NAME,
+        TIMER_COMMIT_EDITS,
+        TIMER_LAYOUT_LATENCY, // From asking the layout worker to picking up its result
+        TIMER_PERSISTENCE_STALL, // UI thread time spent handing edits to the persistence thread
+        TIMER_JOURNAL_WRITE, // On the persistence thread
+        TIMER_DATABASE_WRITE, // On the persistence thread
+        _TIMER_COUNT
+    };
+
+    enum Counter {
+        COUNTER_VISIBLE_LABELS,
+        COUNTER_SKIPPED_LABELS,
+        COUNTER_DRAW_CALLS,
+        COUNTER_ALLOCATIONS,
+        COUNTER_RENDER_ALLOCATIONS, // Inside the waterfall handlers only, 0 once warmed up
+        COUNTER_STALE_FRAMES, // Drawn from a layout of a view panned since
+        COUNTER_SYNC_LAYOUTS, // Laid out on the UI thread
+        COUNTER_DETAIL_CHANGES, // Overlay detail dropped or restored to fit the frame budget
+        COUNTER_PERSISTENCE_QUEUED, // Tasks waiting on the persistence thread, sampled once per frame
+        COUNTER_JOURNAL_KB, // Journal handed over since the last database write, sampled once per frame
+        _COUNTER_COUNT
+    };
+
+#ifdef BOOKMARK_MANAGER_DIAGNOSTICS
+    void record(Timer timer, double ms);
+    void count(Counter counter, uint64_t n);
+
+    // Draws the statistics, to be called from within a menu
+    void draw(const std::string& id);
+
+    // Writes one line per timer and counter with its percentiles
+    bool exportCsv(const std::string& path, std::string& error);
+
+    class ScopeTimer {
+    public:
+        ScopeTimer(Timer timer) : timer(timer), start(std::chrono::steady_clock::now()) {}
+
+        ~ScopeTimer() {
+            record(timer, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+
+    private:
+        Timer timer;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    // Allocations made on this thread so far
+    uint64_t allocationCount();
+
+    // Counts the allocations made during its lifetime
+    class ScopeAllocations {
+    public:
+        ScopeAllocations(Counter counter) : counter(counter), start(allocationCount()) {}
+        ~ScopeAllocations() { count(counter, allocationCount() - start); }
+
+    private:
+        Counter counter;
+        uint64_t start;
+    };
+#endif
+}
+
+#ifdef BOOKMARK_MANAGER_DIAGNOSTICS
+#define DIAG_SCOPE(timer) diag::ScopeTimer _diagScope(timer)
+#define DIAG_COUNT(counter, n) diag::count(counter, n)
+#define DIAG_RECORD(timer, ms) diag::record(timer, ms)
+#define DIAG_ALLOCATIONS(counter) diag::ScopeAllocations _diagAllocations(counter)
+#else
+#define DIAG_SCOPE(timer)
+#define DIAG_COUNT(counter, n)
+#define DIAG_RECORD(timer, ms)
+#define DIAG_ALLOCATIONS(counter)
+#endif
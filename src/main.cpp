@@ -13,7 +13,26 @@
 #include <utils/freq_formatting.h>
 #include <gui/dialogs/dialog_box.h>
 #include <fstream>
+#include <chrono>
 #include "utc.h"
+#include "frequency_index.h"
+#include "overlay_layout.h"
+#include "bookmark_clusters.h"
+#include "overlay_worker.h"
+#include "frame_governor.h"
+#include "bookmark_filter.h"
+#include "bookmark.h"
+#include "bookmark_store.h"
+#include "schedule.h"
+#include "selection_set.h"
+#include "sorted_bookmarks.h"
+#include "bookmark_search.h"
+#include "bookmark_import.h"
+#include "bookmark_db.h"
+#include "bookmark_persistence.h"
+#include "diagnostics.h"
+#include <filesystem>
+#include <unordered_set>
 
 SDRPP_MOD_INFO{
     /* Name:            */ "bookmark_manager",
@@ -23,33 +42,31 @@ SDRPP_MOD_INFO{
     /* Max instances    */ 1
 };
 
-constexpr auto MAX_LINES = 10;
-
-struct FrequencyBookmark {
-    double frequency;
-    double bandwidth;
-    int mode;
-    bool selected;
-    int startTime;
-    int endTime;
-    bool days[7];
-    std::string notes;
-    std::string geoinfo;
-};
-
-struct WaterfallBookmark {
-    std::string listName;
-    std::string bookmarkName;
-    ImU32 color;
-    FrequencyBookmark bookmark;
-    ImVec2 clampedRectMin;
-    ImVec2 clampedRectMax;
-};
-
-struct BookmarkRectangle {
-    double min;
-    double max;
-    int row;
+// Inputs the overlay layout depends on
+struct OverlayLayoutKey {
+    double lowFreq;
+    double highFreq;
+    float minX, minY, maxX, maxY;
+    float fontSize;
+    int displayMode;
+    int rows;
+    bool rectangle;
+    bool centered;
+    bool noClutter;
+    bool clusters;
+    int detail;
+    uint64_t generation;
+    // Label colors show whether a bookmark is on air
+    uint64_t scheduleGeneration;
+
+    bool operator==(const OverlayLayoutKey& other) const {
+        return lowFreq == other.lowFreq && highFreq == other.highFreq
+            && minX == other.minX && minY == other.minY && maxX == other.maxX && maxY == other.maxY
+            && fontSize == other.fontSize && displayMode == other.displayMode && rows == other.rows
+            && rectangle == other.rectangle && centered == other.centered && noClutter == other.noClutter
+            && clusters == other.clusters && detail == other.detail
+            && generation == other.generation && scheduleGeneration == other.scheduleGeneration;
+    }
 };
 
 ConfigManager config;
@@ -66,6 +83,7 @@ const char* demodModeList[] = {
 };
 
 const char* demodModeListTxt = "NFM\0WFM\0AM\0DSB\0USB\0CW\0LSB\0RAW\0";
+static_assert(sizeof(demodModeList) / sizeof(demodModeList[0]) == BOOKMARK_MODE_COUNT);
 
 enum {
     BOOKMARK_DISP_MODE_OFF,
@@ -74,71 +92,17 @@ enum {
     _BOOKMARK_DISP_MODE_COUNT
 };
 
-const char* bookmarkDisplayModesTxt = "Off\0Top\0Bottom\0";
-const char* bookmarkRowsTxt = "1\0""2\0""3\0""4\0""5\0""6\0""7\0""8\0""9\0""10\0";
-
-bool compareWaterfallBookmarks(WaterfallBookmark wbm1, WaterfallBookmark wbm2) {
-    return (wbm1.bookmark.frequency < wbm2.bookmark.frequency);
-}
-
-// Define the comparator lambda function
-auto comparatorFreqAsc = [](const std::pair<std::string, FrequencyBookmark>& a, const std::pair<std::string, FrequencyBookmark>& b) {
-    return a.second.frequency < b.second.frequency;
-};
-
-auto comparatorFreqDesc = [](const std::pair<std::string, FrequencyBookmark>& a, const std::pair<std::string, FrequencyBookmark>& b) {
-    return a.second.frequency > b.second.frequency;
-};
-
-
-bool compareBookmarksFreq(FrequencyBookmark bm1, FrequencyBookmark bm2) {
-    return (bm1.frequency < bm2.frequency);
-}
-
-bool timeValid(int time) {
-    // Check HHMM time validity.
-    int hours = time / 100;
-    int minutes = time % 100;
-
-    return (hours >= 0 && hours <= 23 && minutes >= 0 && minutes <= 59);
-}
-
-bool bookmarkOnline(FrequencyBookmark bm, int now, int weekDay) {
-    if (!bm.days[weekDay]) {
-        return false;
-    }
+const char* searchModesTxt = "Any\0NFM\0WFM\0AM\0DSB\0USB\0CW\0LSB\0RAW\0";
 
-    if (bm.startTime == 0 && bm.endTime == 0) {
-        return true;
-    } else if (bm.startTime < bm.endTime) {
-        return (bm.startTime <= now) && (now < bm.endTime);
-    } else if (bm.startTime > bm.endTime) {
-        return ((bm.startTime <= now) && (now <= 2359))
-            || ((bm.startTime >= 0) && (now <= bm.endTime));
-    } else {
-        return false; // When start and end times are equal (except 0000).
-    }
-}
+// Time a search may take per frame, the rest carries over to the next frames
+constexpr double SEARCH_BUDGET_MS = 2.0;
 
-ImU32 hexStrToColor(std::string col) {
-    // std::cout << "hexStrToColor: " << col << std::endl;
-
-    int r, g, b;
-
-    if (col[0] == '#' && std::all_of(col.begin() + 1, col.end(), ::isxdigit)) {
-        r = std::stoi(col.substr(1, 2), NULL, 16);
-        g = std::stoi(col.substr(3, 2), NULL, 16);
-        b = std::stoi(col.substr(5, 2), NULL, 16);
-        // std::cout << "  color is: " << r << " " << g << " " << b << std:: endl;
-    } else {
-        r = 255;
-        g = 255;
-        b = 0;
-        // std::cout << "  color is not valid, returning default";
-    }
+// Part of the view width a worker layout may be panned by and still be drawn,
+// shifted, while the worker catches up
+constexpr float MAX_STALE_PAN = 0.25f;
 
-    return IM_COL32(r, g, b, 255);
-}
+const char* bookmarkDisplayModesTxt = "Off\0Top\0Bottom\0";
+const char* bookmarkRowsTxt = "1\0""2\0""3\0""4\0""5\0""6\0""7\0""8\0""9\0""10\0";
 
 ImVec4 color32ToVec4(ImU32 col) {
     ImVec4 val;
@@ -164,8 +128,17 @@ public:
         bookmarkRectangle = config.conf["bookmarkRectangle"];
         bookmarkCentered = config.conf["bookmarkCentered"];
         bookmarkNoClutter = config.conf["bookmarkNoClutter"];
+        bookmarkClusters = config.conf["bookmarkClusters"];
+        overlayBudget = config.conf["overlayBudget"];
+        hideOffline = config.conf["hideOffline"];
         config.release();
+        governor.setBudget(overlayBudget);
+        updateOverlayFilter();
 
+        dbPath = core::args["root"].s() + "/bookmark_manager.db";
+        journalPath = core::args["root"].s() + "/bookmark_manager.journal";
+        loadStore();
+        searchIndex.build(store);
         refreshLists();
         loadByName(selList);
         refreshWaterfallBookmarks();
@@ -184,6 +157,9 @@ public:
         gui::menu.removeEntry(name);
         gui::waterfall.onFFTRedraw.unbindHandler(&fftRedrawHandler);
         gui::waterfall.onInputProcess.unbindHandler(&inputHandler);
+
+        // Leave a database that includes every edit
+        persistence.close(store);
     }
 
     void postInit() {}
@@ -341,19 +317,18 @@ private:
 
             bool applyDisabled = 
                 (strlen(nameBuf) == 0) 
-                || (bookmarks.find(editedBookmarkName) != bookmarks.end() && editedBookmarkName != firstEditedBookmarkName)
+                || (store.find(loadedList, editedBookmarkName) != INVALID_BOOKMARK && editedBookmarkName != firstEditedBookmarkName)
                 || !timeValid(editedBookmark.startTime) || !timeValid(editedBookmark.endTime);
             if (applyDisabled) { style::beginDisabled(); }
             if (ImGui::Button("Apply")) {
                 open = false;
 
-                // If editing, delete the original one
                 if (editOpen) {
-                    bookmarks.erase(firstEditedBookmarkName);
+                    updateBookmark(store.find(loadedList, firstEditedBookmarkName), editedBookmarkName, editedBookmark);
+                }
+                else {
+                    addBookmark(loadedList, editedBookmarkName, editedBookmark);
                 }
-                bookmarks[editedBookmarkName] = editedBookmark;
-
-                saveByName(selectedListName);
             }
             if (applyDisabled) { style::endDisabled(); }
             ImGui::SameLine();
@@ -401,24 +376,21 @@ private:
             if (ImGui::Button("Apply")) {
                 open = false;
 
-                config.acquire();
+                ListId list;
                 if (renameListOpen) {
+                    list = store.findList(firstEditedListName);
                     if (strcmp(firstEditedListName.c_str(), nameBuf) != 0) {
-                        config.conf["lists"][editedListName] = config.conf["lists"][firstEditedListName];
-                        config.conf["lists"].erase(firstEditedListName);
+                        renameList(list, editedListName);
                     }
                 }
                 else {
-                    config.conf["lists"][editedListName]["showOnWaterfall"] = true;
-                    config.conf["lists"][editedListName]["bookmarks"] = json::object();
+                    list = addList(editedListName);
                 }
 
                 char buf[16];
                 sprintf(buf, "#%02X%02X%02X", (int)roundf(editedListColor.x * 255), (int)roundf(editedListColor.y * 255), (int)roundf(editedListColor.z * 255));
-                config.conf["lists"][editedListName]["color"] = buf;
+                setListColor(list, buf);
 
-                refreshWaterfallBookmarks(false);
-                config.release(true);
                 refreshLists();
                 loadByName(editedListName);
             }
@@ -443,20 +415,25 @@ private:
         bool open = true;
 
         if (ImGui::BeginPopup(id.c_str(), ImGuiWindowFlags_NoResize)) {
-            // No need to lock config since we're not modifying anything and there's only one instance
-            for (auto [listName, list] : config.conf["lists"].items()) {
-                bool shown = list["showOnWaterfall"];
+            for (auto const& listName : listNames) {
+                ListId list = store.findList(listName);
+                bool shown = store.getList(list).shown;
                 if (ImGui::Checkbox((listName + "##freq_manager_sel_list_").c_str(), &shown)) {
-                    config.acquire();
-                    config.conf["lists"][listName]["showOnWaterfall"] = shown;
-                    refreshWaterfallBookmarks(false);
-                    config.release(true);
+                    setListVisible(list, shown);
                 }
             }
 
             if (ImGui::Button("Ok")) {
                 open = false;
             }
+            ImGui::SameLine();
+            // Every list, in the layout of the old config file
+            if (ImGui::Button("Export all") && !exportOpen) {
+                exportedBookmarks = json::object();
+                exportedBookmarks["lists"] = storeToJson(store);
+                exportOpen = true;
+                exportDialog = new pfd::save_file("Export lists", "", { "JSON Files (*.json)", "*.json", "All Files", "*" }, true);
+            }
             ImGui::EndPopup();
         }
         return open;
@@ -464,69 +441,601 @@ private:
 
     void refreshLists() {
         listNames.clear();
-        sortSpecsDirty = true;
+        sortedBookmarks.markDirty();
         listNamesTxt = "";
 
-        config.acquire();
-        for (auto [_name, list] : config.conf["lists"].items()) {
-            listNames.push_back(_name);
+        for (ListId list = 0; list < store.listCapacity(); list++) {
+            if (store.getList(list).alive) { listNames.push_back(store.getList(list).name); }
+        }
+        std::sort(listNames.begin(), listNames.end());
+        for (auto const& _name : listNames) {
             listNamesTxt += _name;
             listNamesTxt += '\0';
         }
-        config.release();
     }
 
-    void refreshWaterfallBookmarks(bool lockConfig = true) {
-        if (lockConfig) { config.acquire(); }
+    // Orders waterfall bookmarks by frequency
+    auto byFrequency() const {
+        return [this](const WaterfallBookmark& a, const WaterfallBookmark& b) {
+            return store.frequency(a.id) < store.frequency(b.id);
+        };
+    }
+
+    void loadStore() {
+        std::string error;
+        schedule.invalidateAll();
+        auto warn = [this](const std::string& message) {
+            storeWarning += (storeWarning.empty() ? "" : " ") + message;
+        };
+        if (std::filesystem::exists(dbPath)) {
+            uint64_t dbSequence = 0;
+            if (BookmarkDatabase::load(store, dbPath, error, &dbSequence)) {
+                openJournal(dbSequence);
+                return;
+            }
+            flog::error("Could not load the bookmark database: {0}", error);
+
+            // Keep the damaged database and its journal, the edits in them may
+            // still be recovered by hand
+            std::error_code ec;
+            std::filesystem::rename(dbPath, dbPath + ".bad", ec);
+            warn("The bookmark database could not be loaded (" + error + ") and was renamed to bookmark_manager.db.bad.");
+            if (std::filesystem::exists(journalPath)) {
+                std::filesystem::rename(journalPath, journalPath + ".bad", ec);
+                warn("Its journal of recent edits was renamed to bookmark_manager.journal.bad.");
+            }
+        }
+
+        // Bookmarks used to live in the config file, move them to the database.
+        // A JSON copy of the lists is kept next to it.
+        std::string backupPath = core::args["root"].s() + "/bookmark_manager_lists.json";
+        config.acquire();
+        try {
+            if (config.conf.contains("lists")) {
+                storeFromJson(store, config.conf["lists"]);
+                json backup;
+                backup["lists"] = config.conf["lists"];
+                std::ofstream fs(backupPath);
+                fs << backup;
+            }
+            else if (std::filesystem::exists(backupPath)) {
+                // The copy is only written when moving bookmarks out of the
+                // config, so anything edited since then is missing from it
+                flog::warn("Restoring bookmarks from {0}", backupPath);
+                std::ifstream fs(backupPath);
+                json backup;
+                fs >> backup;
+                storeFromJson(store, backup["lists"]);
+                warn("Bookmarks were restored from bookmark_manager_lists.json, the copy made when they were moved out of the config: changes made since are missing.");
+            }
+            else {
+                store.clear();
+                store.addList("General", DEFAULT_LIST_COLOR, true);
+            }
+        }
+        catch (const std::exception& e) {
+            flog::error("Could not read the bookmark lists: {0}", e.what());
+            warn(std::string("The bookmark lists could not be read (") + e.what() + "), starting with an empty list.");
+            store.clear();
+            store.addList("General", DEFAULT_LIST_COLOR, true);
+        }
+
+        if (BookmarkDatabase::save(store, dbPath, error)) {
+            config.conf.erase("lists");
+            config.release(true);
+        }
+        else {
+            config.release();
+            flog::error("Could not create the bookmark database: {0}", error);
+        }
+
+        // A journal left over belongs to a database that is gone, keep it
+        // aside instead of replaying it onto other bookmarks
+        if (std::filesystem::exists(journalPath)) {
+            std::error_code ec;
+            std::filesystem::rename(journalPath, journalPath + ".bad", ec);
+        }
+        // Shown in the menu until dismissed
+        if (!storeWarning.empty()) { flog::warn("{0}", storeWarning); }
+        openJournal(0);
+    }
+
+    void openJournal(uint64_t dbSequence) {
+        size_t replayed = 0;
+        std::string error;
+        if (!persistence.open(dbPath, journalPath, store, dbSequence, replayed, error)) {
+            flog::error("Could not open the edit journal, edits will rewrite the database: {0}", error);
+            storeWarning += (storeWarning.empty() ? "" : " ") + ("The edit journal could not be opened (" + error + "), edits are saved by rewriting the whole database, at most once a second.");
+        }
+        else if (!error.empty()) {
+            flog::error("{0}", error);
+            storeWarning += (storeWarning.empty() ? "" : " ") + std::string("The edit journal could not be read and was renamed to bookmark_manager.journal.bad, recent edits may be missing.");
+        }
+        if (replayed > 0) {
+            flog::info("Recovered {0} edits from the journal", replayed);
+        }
+    }
+
+    // Hands the journaled edits to the persistence thread, the database is
+    // only rewritten once the journal has grown large
+    void commitEdits() {
+        DIAG_SCOPE(diag::TIMER_COMMIT_EDITS);
+        persistence.commit(store);
+    }
+
+    // Config writes go through the persistence thread too, so saving the
+    // config file never holds up a frame
+    void saveSetting(const std::string& key, json value) {
+        persistence.post([key, value = std::move(value)]() {
+            config.acquire();
+            config.conf[key] = value;
+            config.release(true);
+        });
+    }
+
+    void refreshWaterfallBookmarks() {
+        DIAG_SCOPE(diag::TIMER_REFRESH_WATERFALL);
         waterfallBookmarks.clear();
-        for (auto [listName, list] : config.conf["lists"].items()) {
-            if (!((bool)list["showOnWaterfall"])) { continue; }
-            WaterfallBookmark wbm;
-            wbm.listName = listName;
-            wbm.color = IM_COL32(255, 255, 0, 255);
-
-            if (list.contains("color")) {
-                // std::cout << "List " << listName << " is of color " << list["color"] << std::endl;
-                // std::cout << "Default color: " << wbm.color << std::endl;
-                wbm.color = hexStrToColor(list["color"]);
+        waterfallGeneration++;
+        for (BookmarkId id = 0; id < store.capacity(); id++) {
+            if (!store.valid(id) || !store.getList(store.listOf(id)).shown) { continue; }
+            waterfallBookmarks.push_back(makeWaterfallBookmark(id));
+        }
+        std::sort(waterfallBookmarks.begin(), waterfallBookmarks.end(), byFrequency());
+        rebuildWaterfallIndex();
+    }
+
+    void rebuildWaterfallIndex() {
+        waterfallIndex.clear();
+        waterfallIndex.reserve(waterfallBookmarks.size());
+        for (auto const& wbm : waterfallBookmarks) {
+            waterfallIndex.push(store.frequency(wbm.id));
+        }
+    }
+
+    // Labels are measured here, on the UI thread, with the font of the last
+    // frame. Before the first frame they are left for updateLabelMetrics().
+    WaterfallBookmark makeWaterfallBookmark(BookmarkId id) const {
+        WaterfallBookmark wbm;
+        wbm.id = id;
+        wbm.color = store.color(id);
+        wbm.frequency = store.frequency(id);
+        wbm.nameSize = labelFont ? measureLabel(labelFont, labelFontSize, store.name(id)) : ImVec2(-1, -1);
+        wbm.nameLength = strlen(store.name(id));
+        return wbm;
+    }
+
+    // The clock is read once per frame, by whichever of the menu and the
+    // overlay draws first, so everything drawn in the frame agrees on the time
+    void updateSchedule() {
+        int frame = ImGui::GetFrameCount();
+        if (frame != clockFrame) {
+            clockFrame = frame;
+            frameMinute = utc::now().epochMinute();
+        }
+        schedule.update(store, frameMinute);
+    }
+
+    // Measures every label again when the font or the UI scale changed
+    void updateLabelMetrics() {
+        const ImFont* font = ImGui::GetFont();
+        float fontSize = ImGui::GetFontSize();
+        if (font == labelFont && fontSize == labelFontSize) { return; }
+        labelFont = font;
+        labelFontSize = fontSize;
+        for (auto& wbm : waterfallBookmarks) {
+            wbm.nameSize = measureLabel(labelFont, labelFontSize, store.name(wbm.id));
+        }
+        waterfallGeneration++;
+    }
+
+    void insertWaterfallBookmark(BookmarkId id) {
+        // Binary search for the position, then shift the tail over by one entry
+        double frequency = store.frequency(id);
+        size_t pos = waterfallIndex.insertPos(frequency);
+        waterfallBookmarks.insert(waterfallBookmarks.begin() + pos, makeWaterfallBookmark(id));
+        waterfallIndex.insert(pos, frequency);
+        waterfallGeneration++;
+    }
+
+    void eraseWaterfallBookmark(BookmarkId id) {
+        double frequency = store.frequency(id);
+        auto [first, last] = waterfallIndex.range(frequency, frequency);
+        for (size_t i = first; i < last; i++) {
+            if (waterfallBookmarks[i].id == id) {
+                waterfallBookmarks.erase(waterfallBookmarks.begin() + i);
+                waterfallIndex.erase(i);
+                waterfallGeneration++;
+                return;
             }
+        }
+    }
 
-            for (auto [bookmarkName, bm] : config.conf["lists"][listName]["bookmarks"].items()) {
-                wbm.bookmarkName = bookmarkName;
-                wbm.bookmark.frequency = bm["frequency"];
-                wbm.bookmark.bandwidth = bm["bandwidth"];
-                wbm.bookmark.startTime = bm.contains("startTime") ? (int)bm["startTime"] : 0;
-                wbm.bookmark.endTime = bm.contains("endTime") ? (int)bm["endTime"] : 0;
-                
-                if (bm.contains("days")) {
-                    std::copy(bm["days"].begin(), bm["days"].end(), wbm.bookmark.days);
-                } else {
-                    for (int i = 0; i < 7; i++) {
-                        wbm.bookmark.days[i] = true;
-                    }
+    void eraseWaterfallList(ListId list) {
+        size_t oldCount = waterfallBookmarks.size();
+        waterfallBookmarks.erase(std::remove_if(waterfallBookmarks.begin(), waterfallBookmarks.end(), [this, list](const WaterfallBookmark& wbm) {
+            return store.listOf(wbm.id) == list;
+        }), waterfallBookmarks.end());
+        if (waterfallBookmarks.size() != oldCount) {
+            rebuildWaterfallIndex();
+            waterfallGeneration++;
+        }
+    }
+
+    // Single edits below are recorded in the edit journal, then patch the
+    // store, the loaded list and the waterfall bookmarks in place instead of
+    // rebuilding everything.
+
+    BookmarkId addBookmark(ListId list, const std::string& bmName, const FrequencyBookmark& bm) {
+        persistence.journal().addBookmark(store.getList(list).name, bmName, bm);
+        BookmarkId id = store.add(list, bmName, bm);
+        schedule.invalidate(id);
+        searchIndex.add(store, id);
+        searchDirty = true;
+        if (store.getList(list).shown) {
+            insertWaterfallBookmark(id);
+        }
+        if (list == loadedList) {
+            sortedBookmarks.insert(store, schedule, id);
+        }
+        commitEdits();
+        return id;
+    }
+
+    void addBookmarks(ListId list, const std::vector<std::pair<std::string, FrequencyBookmark>>& newBookmarks) {
+        if (newBookmarks.empty()) { return; }
+
+        bool shown = store.getList(list).shown;
+        size_t oldCount = waterfallBookmarks.size();
+        std::vector<BookmarkId> added;
+        for (auto const& [bmName, bm] : newBookmarks) {
+            persistence.journal().addBookmark(store.getList(list).name, bmName, bm);
+            BookmarkId id = store.add(list, bmName, bm);
+            schedule.invalidate(id);
+            searchIndex.add(store, id);
+            if (shown) { waterfallBookmarks.push_back(makeWaterfallBookmark(id)); }
+            added.push_back(id);
+        }
+        searchDirty = true;
+
+        // Sort only the new entries and merge them into the existing order
+        if (shown) {
+            std::sort(waterfallBookmarks.begin() + oldCount, waterfallBookmarks.end(), byFrequency());
+            std::inplace_merge(waterfallBookmarks.begin(), waterfallBookmarks.begin() + oldCount, waterfallBookmarks.end(), byFrequency());
+            rebuildWaterfallIndex();
+            waterfallGeneration++;
+        }
+        if (list == loadedList) { sortedBookmarks.insert(store, schedule, added); }
+        commitEdits();
+    }
+
+    void removeBookmark(BookmarkId id) {
+        if (!store.valid(id)) { return; }
+        ListId list = store.listOf(id);
+
+        if (store.getList(list).shown) {
+            eraseWaterfallBookmark(id);
+        }
+        sortedBookmarks.erase(store, id);
+        selection.remove(id);
+        searchIndex.remove(store, id);
+        searchDirty = true;
+        if (searchSelected == id) { searchSelected = INVALID_BOOKMARK; }
+        persistence.journal().removeBookmark(store.getList(list).name, store.name(id));
+        store.remove(id);
+        schedule.invalidate(id);
+        commitEdits();
+    }
+
+    void updateBookmark(BookmarkId id, const std::string& newName, const FrequencyBookmark& bm) {
+        if (!store.valid(id)) { return; }
+        ListId list = store.listOf(id);
+
+        // The bookmark keeps its id, only its place on the waterfall can change
+        bool shown = store.getList(list).shown;
+        if (shown) { eraseWaterfallBookmark(id); }
+        bool listed = sortedBookmarks.contains(id);
+        sortedBookmarks.erase(store, id);
+        searchIndex.remove(store, id);
+        persistence.journal().updateBookmark(store.getList(list).name, store.name(id), newName, bm);
+        store.update(id, newName, bm);
+        schedule.invalidate(id);
+        searchIndex.add(store, id);
+        searchDirty = true;
+        if (shown) { insertWaterfallBookmark(id); }
+        if (listed) { sortedBookmarks.insert(store, schedule, id); }
+        commitEdits();
+    }
+
+    void renameBookmark(BookmarkId id, const std::string& newName) {
+        if (!store.valid(id) || newName == store.name(id)) { return; }
+        updateBookmark(id, newName, store.get(id));
+    }
+
+    ListId addList(const std::string& listName) {
+        persistence.journal().addList(listName, DEFAULT_LIST_COLOR, true);
+        ListId list = store.addList(listName, DEFAULT_LIST_COLOR, true);
+        commitEdits();
+        return list;
+    }
+
+    void removeList(ListId list) {
+        eraseWaterfallList(list);
+        if (list == loadedList) {
+            selection.clear();
+            sortedBookmarks.clear();
+            loadedList = INVALID_LIST;
+        }
+        for (BookmarkId id = 0; id < store.capacity(); id++) {
+            if (store.valid(id) && store.listOf(id) == list) { searchIndex.remove(store, id); }
+        }
+        if (searchSelected != INVALID_BOOKMARK && store.listOf(searchSelected) == list) { searchSelected = INVALID_BOOKMARK; }
+        searchDirty = true;
+        persistence.journal().removeList(store.getList(list).name);
+        store.removeList(list);
+        schedule.invalidateAll();
+        commitEdits();
+    }
+
+    void renameList(ListId list, const std::string& newName) {
+        persistence.journal().renameList(store.getList(list).name, newName);
+        store.renameList(list, newName);
+        commitEdits();
+    }
+
+    void setListColor(ListId list, const std::string& color) {
+        persistence.journal().setListColor(store.getList(list).name, hexStrToColor(color));
+        store.setListColor(list, hexStrToColor(color));
+        for (auto& wbm : waterfallBookmarks) {
+            if (store.listOf(wbm.id) == list) { wbm.color = store.color(wbm.id); }
+        }
+        waterfallGeneration++;
+        commitEdits();
+    }
+
+    void setListVisible(ListId list, bool shown) {
+        if (shown == store.getList(list).shown) { return; }
+        persistence.journal().setListShown(store.getList(list).name, shown);
+        store.setListShown(list, shown);
+        commitEdits();
+
+        if (shown) {
+            // Sort only the list being shown and merge it into the existing order
+            size_t oldCount = waterfallBookmarks.size();
+            for (BookmarkId id = 0; id < store.capacity(); id++) {
+                if (store.valid(id) && store.listOf(id) == list) {
+                    waterfallBookmarks.push_back(makeWaterfallBookmark(id));
                 }
+            }
+            std::sort(waterfallBookmarks.begin() + oldCount, waterfallBookmarks.end(), byFrequency());
+            std::inplace_merge(waterfallBookmarks.begin(), waterfallBookmarks.begin() + oldCount, waterfallBookmarks.end(), byFrequency());
+            rebuildWaterfallIndex();
+            waterfallGeneration++;
+        }
+        else {
+            eraseWaterfallList(list);
+        }
+    }
+
+    // Frequency and mode column of the bookmark table, formatted once and
+    // kept until either changes
+    const char* frequencyText(BookmarkId id) {
+        if (id >= frequencyTexts.size()) { frequencyTexts.resize(store.capacity()); }
+        FrequencyText& ft = frequencyTexts[id];
+        if (ft.text.empty() || ft.frequency != store.frequency(id) || ft.mode != store.mode(id)) {
+            ft.frequency = store.frequency(id);
+            ft.mode = store.mode(id);
+            ft.text = utils::formatFreq(ft.frequency) + " " + demodModeList[ft.mode];
+        }
+        return ft.text.c_str();
+    }
 
-                if (bm.contains("geoinfo")) {
-                    wbm.bookmark.geoinfo = bm["geoinfo"];
-                } else {
-                    wbm.bookmark.geoinfo = "";
+    // Formatted values of the label tooltip, only redone when another
+    // bookmark is hovered or the hovered one changed
+    void formatTooltip(BookmarkId id) {
+        if (id == tooltipBookmark && tooltipValues[0] == store.frequency(id) && tooltipValues[1] == store.bandwidth(id)) { return; }
+        tooltipBookmark = id;
+        tooltipValues[0] = store.frequency(id);
+        tooltipValues[1] = store.bandwidth(id);
+        tooltipFrequency = utils::formatFreq(tooltipValues[0]);
+        tooltipBandwidth = utils::formatFreq(tooltipValues[1]);
+    }
+
+    // Click on a row of the bookmark table. Shift selects the rows between the
+    // anchor and this one in the current sort order, control toggles the row.
+    void clickBookmark(BookmarkId id) {
+        bool shift = ImGui::GetIO().KeyShift;
+        bool ctrl = ImGui::GetIO().KeyCtrl;
+
+        if (shift && selection.anchor != INVALID_BOOKMARK) {
+            const std::vector<BookmarkId>& rows = sortedBookmarks.ids();
+            auto anchorRow = std::find(rows.begin(), rows.end(), selection.anchor);
+            auto clickedRow = std::find(rows.begin(), rows.end(), id);
+            if (anchorRow != rows.end() && clickedRow != rows.end()) {
+                BookmarkId anchor = selection.anchor;
+                if (!ctrl) { selection.clear(); }
+                if (clickedRow < anchorRow) { std::swap(anchorRow, clickedRow); }
+                for (auto it = anchorRow; it <= clickedRow; it++) {
+                    selection.add(*it);
                 }
+                selection.anchor = anchor;
+                return;
+            }
+        }
+
+        if (ctrl || shift) {
+            selection.toggle(id);
+        }
+        else {
+            // A plain click on the only selected row deselects it
+            bool wasSelected = selection.contains(id);
+            selection.clear();
+            if (!wasSelected) { selection.add(id); }
+        }
+        selection.anchor = selection.contains(id) ? id : INVALID_BOOKMARK;
+    }
+
+    // Narrows down the bookmarks shown on the waterfall, along with the saved
+    // "Hide bookmarks not on air" setting. Lasts until SDR++ is closed.
+    void overlayFilterMenu(float menuWidth) {
+        bool changed = false;
+
+        ImGui::LeftLabel("Name");
+        ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+        changed |= ImGui::InputText(("##_freq_mgr_wf_filter_name_" + name).c_str(), filterName, sizeof(filterName) - 1);
+
+        ImGui::LeftLabel("Mode");
+        ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+        changed |= ImGui::Combo(("##_freq_mgr_wf_filter_mode_" + name).c_str(), &filterMode, searchModesTxt);
+
+        // The list is kept by id, so it follows renames and is dropped with the list
+        if (filterList != INVALID_LIST && (filterList >= store.listCapacity() || !store.getList(filterList).alive)) {
+            filterList = INVALID_LIST;
+            changed = true;
+        }
+        int listIndex = 0;
+        if (filterList != INVALID_LIST) {
+            auto it = std::find(listNames.begin(), listNames.end(), store.getList(filterList).name);
+            if (it != listNames.end()) { listIndex = (int)(it - listNames.begin()) + 1; }
+        }
+        std::string listsTxt = std::string("Any", 4) + listNamesTxt;
+        ImGui::LeftLabel("List");
+        ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+        if (ImGui::Combo(("##_freq_mgr_wf_filter_list_" + name).c_str(), &listIndex, listsTxt.c_str())) {
+            filterList = (listIndex > 0) ? store.findList(listNames[listIndex - 1]) : INVALID_LIST;
+            changed = true;
+        }
+
+        ImGui::LeftLabel("Bandwidth from (Hz)");
+        ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+        changed |= ImGui::InputDouble(("##_freq_mgr_wf_filter_min_bw_" + name).c_str(), &filterMinBandwidth, 0, 0, "%.0f");
+
+        ImGui::LeftLabel("Bandwidth to (Hz)");
+        ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+        changed |= ImGui::InputDouble(("##_freq_mgr_wf_filter_max_bw_" + name).c_str(), &filterMaxBandwidth, 0, 0, "%.0f");
+
+        if (changed) { updateOverlayFilter(); }
+    }
+
+    // Rebuilt from the menu only, so drawing the overlay never copies it
+    void updateOverlayFilter() {
+        overlayFilter.onlineOnly = hideOffline;
+        overlayFilter.modes = (filterMode > 0) ? (1u << (filterMode - 1)) : 0;
+        overlayFilter.lists.clear();
+        if (filterList != INVALID_LIST) { overlayFilter.lists.push_back(filterList); }
+        overlayFilter.minBandwidth = filterMinBandwidth;
+        overlayFilter.maxBandwidth = filterMaxBandwidth;
+        overlayFilter.name = filterName;
+    }
+
+    // Search box, filters and results over every list. The search runs a
+    // budget at a time and restarts whenever the filter or the store changes.
+    void searchMenu(float menuWidth) {
+        ImGui::LeftLabel("Search");
+        ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+        ImGui::InputText(("##_freq_mgr_search_" + name).c_str(), searchText, sizeof(searchText) - 1);
+
+        ImGui::LeftLabel("Mode");
+        ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+        ImGui::Combo(("##_freq_mgr_search_mode_" + name).c_str(), &searchMode, searchModesTxt);
+
+        ImGui::LeftLabel("From (Hz)");
+        ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+        ImGui::InputDouble(("##_freq_mgr_search_min_" + name).c_str(), &searchMinFrequency, 0, 0, "%.0f");
 
-                if (bm.contains("notes")) {
-                    wbm.bookmark.notes = bm["notes"];
-                } else {
-                    wbm.bookmark.notes = "";
+        ImGui::LeftLabel("To (Hz)");
+        ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+        ImGui::InputDouble(("##_freq_mgr_search_max_" + name).c_str(), &searchMaxFrequency, 0, 0, "%.0f");
+
+        ImGui::Checkbox(("On air now##_freq_mgr_search_online_" + name).c_str(), &searchOnlineOnly);
+
+        SearchFilter filter;
+        filter.text = searchText;
+        filter.mode = searchMode - 1;
+        filter.minFrequency = searchMinFrequency;
+        filter.maxFrequency = searchMaxFrequency;
+        filter.onlineOnly = searchOnlineOnly;
+
+        updateSchedule();
+        bool scheduleChanged = filter.onlineOnly && schedule.generation() != searchScheduleGeneration;
+        if (filter != search.filter() || searchDirty || scheduleChanged) {
+            if (filter.active()) {
+                search.start(searchIndex, store, filter);
+            }
+            else {
+                search.clear();
+            }
+            searchDirty = false;
+            searchScheduleGeneration = schedule.generation();
+        }
+        search.step(store, schedule, SEARCH_BUDGET_MS);
+
+        const std::vector<BookmarkId>& results = search.results();
+        if (search.running()) {
+            ImGui::Text("Searching... %zu found", results.size());
+        }
+        else if (filter.active()) {
+            ImGui::Text("%zu found", results.size());
+        }
+
+        if (ImGui::BeginTable(("freq_manager_search_table" + name).c_str(), 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable, ImVec2(0, 150.0f * style::uiScale))) {
+            ImGui::TableSetupColumn("Name");
+            ImGui::TableSetupColumn("Bookmark");
+            ImGui::TableSetupColumn("List");
+            ImGui::TableSetupScrollFreeze(1, 1);
+            ImGui::TableHeadersRow();
+
+            ImGuiListClipper clipper;
+            clipper.Begin(results.size());
+            while (clipper.Step()) {
+                for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                    BookmarkId id = results[row];
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::PushID((int)id);
+
+                    if (ImGui::Selectable(store.name(id), searchSelected == id, ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_SelectOnClick)) {
+                        searchSelected = (searchSelected == id) ? INVALID_BOOKMARK : id;
+                    }
+                    if (ImGui::TableGetHoveredColumn() >= 0 && ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
+                        applyBookmark(store.get(id), gui::waterfall.selectedVFO);
+                        searchSelected = id;
+                    }
+
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::TextUnformatted(frequencyText(id));
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::TextUnformatted(store.getList(store.listOf(id)).name.c_str());
+                    ImGui::PopID();
                 }
+            }
+            clipper.End();
+            ImGui::EndTable();
+        }
 
-                wbm.bookmark.mode = bm["mode"];
-                wbm.bookmark.selected = false;
-                wbm.clampedRectMin = ImVec2(-1, -1);
-                wbm.clampedRectMax = ImVec2(-1, -1);
-                waterfallBookmarks.push_back(wbm);
+        // Tune to the result, or open its list with the result selected
+        ImGui::BeginTable(("freq_manager_search_btn_table" + name).c_str(), 2);
+        ImGui::TableNextRow();
+        bool noResult = (searchSelected == INVALID_BOOKMARK);
+        if (noResult) { style::beginDisabled(); }
+        ImGui::TableSetColumnIndex(0);
+        if (ImGui::Button(("Apply##_freq_mgr_search_apply_" + name).c_str(), ImVec2(ImGui::GetContentRegionAvail().x, 0))) {
+            applyBookmark(store.get(searchSelected), gui::waterfall.selectedVFO);
+        }
+        ImGui::TableSetColumnIndex(1);
+        if (ImGui::Button(("Show in list##_freq_mgr_search_show_" + name).c_str(), ImVec2(ImGui::GetContentRegionAvail().x, 0))) {
+            BookmarkId id = searchSelected;
+            if (store.listOf(id) != loadedList) {
+                loadByName(store.getList(store.listOf(id)).name);
+                saveSetting("selectedList", selectedListName);
             }
+            selection.clear();
+            selection.add(id);
+            selection.anchor = id;
+            scrollToClickedBookmark = true;
         }
-        std::sort(waterfallBookmarks.begin(), waterfallBookmarks.end(), compareWaterfallBookmarks);
-        if (lockConfig) { config.release(); }
+        if (noResult) { style::endDisabled(); }
+        ImGui::EndTable();
     }
 
     void loadFirst() {
@@ -536,11 +1045,13 @@ private:
         }
         selectedListName = "";
         selectedListId = 0;
+        loadedList = INVALID_LIST;
     }
 
     void loadByName(std::string listName) {
-        bookmarks.clear();
-        sortSpecsDirty = true;
+        DIAG_SCOPE(diag::TIMER_LOAD_BY_NAME);
+        sortedBookmarks.clear();
+        selection.clear();
         if (std::find(listNames.begin(), listNames.end(), listName) == listNames.end()) {
             selectedListName = "";
             selectedListId = 0;
@@ -549,75 +1060,38 @@ private:
         }
         selectedListId = std::distance(listNames.begin(), std::find(listNames.begin(), listNames.end(), listName));
         selectedListName = listName;
-        config.acquire();
-        for (auto [bmName, bm] : config.conf["lists"][listName]["bookmarks"].items()) {
-            FrequencyBookmark fbm;
-            fbm.frequency = bm["frequency"];
-            fbm.bandwidth = bm["bandwidth"];
-            fbm.startTime = bm.contains("startTime") ? (int)bm["startTime"] : 0;
-            fbm.endTime = bm.contains("endTime") ? (int)bm["endTime"] : 0;
-            
-            if (bm.contains("days")) {
-                std::copy(bm["days"].begin(), bm["days"].end(), fbm.days);
-            } else {
-                for (int i = 0; i < 7; i++) {
-                    fbm.days[i] = true;
-                }
+        loadedList = store.findList(listName);
+        std::vector<BookmarkId> ids;
+        for (BookmarkId id = 0; id < store.capacity(); id++) {
+            if (store.valid(id) && store.listOf(id) == loadedList) {
+                ids.push_back(id);
             }
-
-            if (bm.contains("geoinfo")) {
-                fbm.geoinfo = bm["geoinfo"];
-            } else {
-                fbm.geoinfo = "";
-            }
-
-            if (bm.contains("notes")) {
-                fbm.notes = bm["notes"];
-            } else {
-                fbm.notes = "";
-            }
-
-            fbm.mode = bm["mode"];
-            fbm.selected = false;
-            bookmarks[bmName] = fbm;
         }
-        config.release();
-    }
-
-    void saveByName(std::string listName) {
-        config.acquire();
-        config.conf["lists"][listName]["bookmarks"] = json::object();
-        for (auto [bmName, bm] : bookmarks) {
-            config.conf["lists"][listName]["bookmarks"][bmName]["frequency"] = bm.frequency;
-            config.conf["lists"][listName]["bookmarks"][bmName]["bandwidth"] = bm.bandwidth;
-            config.conf["lists"][listName]["bookmarks"][bmName]["startTime"] = bm.startTime;
-            config.conf["lists"][listName]["bookmarks"][bmName]["endTime"] = bm.endTime;
-            config.conf["lists"][listName]["bookmarks"][bmName]["days"] = bm.days;
-            config.conf["lists"][listName]["bookmarks"][bmName]["geoinfo"] = bm.geoinfo;
-            config.conf["lists"][listName]["bookmarks"][bmName]["notes"] = bm.notes;
-            config.conf["lists"][listName]["bookmarks"][bmName]["mode"] = bm.mode;
-        }
-        refreshWaterfallBookmarks(false);
-        sortSpecsDirty = true;
-        config.release(true);
+        sortedBookmarks.assign(std::move(ids));
     }
 
     static void menuHandler(void* ctx) {
         BookmarkManagerModule* _this = (BookmarkManagerModule*)ctx;
+        DIAG_SCOPE(diag::TIMER_MENU);
+#ifdef BOOKMARK_MANAGER_DIAGNOSTICS
+        _this->persistence.reportDiagnostics();
+#endif
         float menuWidth = ImGui::GetContentRegionAvail().x;
 
-        // TODO: Replace with something that won't iterate every frame
-        std::vector<std::string> selectedNames;
+        _this->commitImport();
 
-        if (selectedNames.size() == 0)
-        {
-            for (auto& [name, bm] : _this->bookmarks) {
-                if (bm.selected) { 
-                    selectedNames.push_back(name); 
-                }
+        if (!_this->storeWarning.empty()) {
+            ImGui::TextWrapped("%s", _this->storeWarning.c_str());
+            if (ImGui::Button(("Dismiss##_freq_mgr_store_warn_" + _this->name).c_str(), ImVec2(menuWidth, 0))) {
+                _this->storeWarning.clear();
             }
+            ImGui::Separator();
         }
 
+        // Taken once so the buttons below are disabled and enabled in pairs
+        // even when a click changes the selection halfway through the frame
+        size_t selectedCount = _this->selection.size();
+
         float lineHeight = ImGui::GetTextLineHeightWithSpacing();
 
         float btnSize = ImGui::CalcTextSize("Rename").x + 8;
@@ -625,9 +1099,7 @@ private:
         ImGui::SetNextItemWidth(sizetarget);
         if (ImGui::Combo(("##freq_manager_list_sel" + _this->name).c_str(), &_this->selectedListId, _this->listNamesTxt.c_str())) {
             _this->loadByName(_this->listNames[_this->selectedListId]);
-            config.acquire();
-            config.conf["selectedList"] = _this->selectedListName;
-            config.release(true);
+            _this->saveSetting("selectedList", _this->selectedListName);
         }
         ImGui::SameLine();
         if (_this->listNames.size() == 0) { style::beginDisabled(); }
@@ -636,11 +1108,7 @@ private:
             _this->editedListName = _this->firstEditedListName;
             _this->renameListOpen = true;
 
-            if (config.conf["lists"][_this->firstEditedListName].contains("color")) {
-                _this->editedListColor = color32ToVec4(hexStrToColor(config.conf["lists"][_this->firstEditedListName]["color"]));
-            } else {
-                _this->editedListColor = ImVec4(1.0f, 1.0f, 0.0f, 1.0f);
-            }
+            _this->editedListColor = color32ToVec4(_this->store.getList(_this->store.findList(_this->firstEditedListName)).color);
         }
         if (_this->listNames.size() == 0) { style::endDisabled(); }
         ImGui::SameLine();
@@ -671,10 +1139,7 @@ private:
         if (ImGui::GenericDialog(("freq_manager_del_list_confirm" + _this->name).c_str(), _this->deleteListOpen, GENERIC_DIALOG_BUTTONS_YES_NO, [_this]() {
                 ImGui::Text("Deleting list named \"%s\". Are you sure?", _this->selectedListName.c_str());
             }) == GENERIC_DIALOG_BUTTON_YES) {
-            config.acquire();
-            config.conf["lists"].erase(_this->selectedListName);
-            _this->refreshWaterfallBookmarks(false);
-            config.release(true);
+            _this->removeList(_this->loadedList);
             _this->refreshLists();
             _this->selectedListId = std::clamp<int>(_this->selectedListId, 0, _this->listNames.size());
             if (_this->listNames.size() > 0) {
@@ -721,163 +1186,175 @@ private:
 
             _this->editedBookmark.notes = "";
 
-            _this->editedBookmark.selected = false;
-
             _this->createOpen = true;
 
             // Find new unique default name
-            if (_this->bookmarks.find("New Bookmark") == _this->bookmarks.end()) {
+            if (_this->store.find(_this->loadedList, "New Bookmark") == INVALID_BOOKMARK) {
                 _this->editedBookmarkName = "New Bookmark";
             }
             else {
                 char buf[64];
                 for (int i = 1; i < 1000; i++) {
                     sprintf(buf, "New Bookmark (%d)", i);
-                    if (_this->bookmarks.find(buf) == _this->bookmarks.end()) { break; }
+                    if (_this->store.find(_this->loadedList, buf) == INVALID_BOOKMARK) { break; }
                 }
                 _this->editedBookmarkName = buf;
             }
         }
 
         ImGui::TableSetColumnIndex(1);
-        if (selectedNames.size() == 0 && _this->selectedListName != "") { style::beginDisabled(); }
+        if (selectedCount == 0 && _this->selectedListName != "") { style::beginDisabled(); }
         if (ImGui::Button(("Remove##_freq_mgr_rem_" + _this->name).c_str(), ImVec2(ImGui::GetContentRegionAvail().x, 0))) {
             _this->deleteBookmarksOpen = true;
         }
-        if (selectedNames.size() == 0 && _this->selectedListName != "") { style::endDisabled(); }
+        if (selectedCount == 0 && _this->selectedListName != "") { style::endDisabled(); }
         ImGui::TableSetColumnIndex(2);
-        if (selectedNames.size() != 1 && _this->selectedListName != "") { style::beginDisabled(); }
+        if (selectedCount != 1 && _this->selectedListName != "") { style::beginDisabled(); }
         if (ImGui::Button(("Edit##_freq_mgr_edt_" + _this->name).c_str(), ImVec2(ImGui::GetContentRegionAvail().x, 0))) {
             _this->editOpen = true;
-            _this->editedBookmark = _this->bookmarks[selectedNames[0]];
-            _this->editedBookmarkName = selectedNames[0];
-            _this->firstEditedBookmarkName = selectedNames[0];
+            _this->editedBookmark = _this->store.get(_this->selection.ids()[0]);
+            _this->editedBookmarkName = _this->store.name(_this->selection.ids()[0]);
+            _this->firstEditedBookmarkName = _this->editedBookmarkName;
         }
-        if (selectedNames.size() != 1 && _this->selectedListName != "") { style::endDisabled(); }
+        if (selectedCount != 1 && _this->selectedListName != "") { style::endDisabled(); }
 
         ImGui::EndTable();
 
-        // Bookmark delete confirm dialog
-        // List delete confirmation
-        if (ImGui::GenericDialog(("freq_manager_del_list_confirm" + _this->name).c_str(), _this->deleteBookmarksOpen, GENERIC_DIALOG_BUTTONS_YES_NO, [_this]() {
+        // Bookmark delete confirmation
+        if (ImGui::GenericDialog(("freq_manager_del_bm_confirm" + _this->name).c_str(), _this->deleteBookmarksOpen, GENERIC_DIALOG_BUTTONS_YES_NO, [_this]() {
                 ImGui::TextUnformatted("Deleting selected bookmaks. Are you sure?");
             }) == GENERIC_DIALOG_BUTTON_YES) {
-            for (auto& _name : selectedNames) { _this->bookmarks.erase(_name); }
-            _this->saveByName(_this->selectedListName);
+            std::vector<BookmarkId> removed = _this->selection.ids();
+            for (BookmarkId id : removed) { _this->removeBookmark(id); }
         }
 
-        // Bookmark list
-        if (ImGui::BeginTable(("freq_manager_bkm_table" + _this->name).c_str(), 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable | ImGuiTableFlags_Sortable, ImVec2(0, 200.0f * style::uiScale))) {
-            ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_DefaultSort, 0.0f, 0);
-            ImGui::TableSetupColumn("Bookmark", ImGuiTableColumnFlags_DefaultSort, 0.0f, 1);
+        // Bookmark list. Columns other than the name and the frequency are
+        // hidden at first and can be shown from the header's context menu.
+        if (ImGui::BeginTable(("freq_manager_bkm_table" + _this->name).c_str(), 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable | ImGuiTableFlags_Hideable | ImGuiTableFlags_Sortable | ImGuiTableFlags_SortMulti, ImVec2(0, 200.0f * style::uiScale))) {
+            ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_DefaultSort, 0.0f, SORT_NAME);
+            ImGui::TableSetupColumn("Bookmark", ImGuiTableColumnFlags_DefaultSort, 0.0f, SORT_FREQUENCY);
+            ImGui::TableSetupColumn("Mode", ImGuiTableColumnFlags_DefaultHide, 0.0f, SORT_MODE);
+            ImGui::TableSetupColumn("Start", ImGuiTableColumnFlags_DefaultHide, 0.0f, SORT_START_TIME);
+            ImGui::TableSetupColumn("On air", ImGuiTableColumnFlags_DefaultHide, 0.0f, SORT_ONLINE);
+            ImGui::TableSetupColumn("List", ImGuiTableColumnFlags_DefaultHide, 0.0f, SORT_LIST);
             ImGui::TableSetupScrollFreeze(2, 1);
             ImGui::TableHeadersRow();
 
-            // Sort by column name or by column bookmark when the column header is clicked
-            if (ImGui::TableGetSortSpecs() != nullptr) {
-                ImGuiTableSortSpecs* sortSpecs = ImGui::TableGetSortSpecs();
-                if (sortSpecs->SpecsDirty || _this->sortSpecsDirty) {
-                    if (sortSpecs->SpecsCount > 0) {
-                        ImGuiTableColumnSortSpecs spec = sortSpecs->Specs[0];
-                        // Sort by Name column
-                        _this->sortedBookmarks.clear();
-                        // Force scroll to selected bookmark
-                        _this->scrollToClickedBookmark = true;
-                        if (spec.ColumnUserID == 0) {
-                            //flog::info("Sort by Name column");
-                            if (spec.SortDirection == ImGuiSortDirection_Descending) {
-                                //flog::info("Sort Descending");
-                                _this->sortedBookmarks.insert(_this->sortedBookmarks.begin(), _this->bookmarks.begin(), _this->bookmarks.end());
-                                std::reverse(_this->sortedBookmarks.begin(), _this->sortedBookmarks.end());
-                            }
-                            if (spec.SortDirection == ImGuiSortDirection_Ascending) {
-                                //flog::info("Sort Ascending");
-                                _this->sortedBookmarks.insert(_this->sortedBookmarks.begin(), _this->bookmarks.begin(), _this->bookmarks.end());
-                            }                            
-                        } else if (spec.ColumnUserID == 1) {
-                            // Sort by Bookmark column
-                            //flog::info("Sort by Bookmarks column");
-                            if (spec.SortDirection == ImGuiSortDirection_Descending) {
-                                //flog::info("Sort Descending");
-                                _this->sortedBookmarks.insert(_this->sortedBookmarks.begin(), _this->bookmarks.begin(), _this->bookmarks.end());
-                                std::sort(_this->sortedBookmarks.begin(), _this->sortedBookmarks.end(), comparatorFreqDesc);
-                            }
-                            if (spec.SortDirection == ImGuiSortDirection_Ascending) {
-                                //flog::info("Sort Ascending");
-                                _this->sortedBookmarks.insert(_this->sortedBookmarks.begin(), _this->bookmarks.begin(), _this->bookmarks.end());
-                                std::sort(_this->sortedBookmarks.begin(), _this->sortedBookmarks.end(), comparatorFreqAsc);
-                            }
-                        }
-                        sortSpecs->SpecsDirty = false;
-                        _this->sortSpecsDirty = false;                
-                    }
+            // Every sorted column is used, in the order they were clicked
+            ImGuiTableSortSpecs* sortSpecs = ImGui::TableGetSortSpecs();
+            if (sortSpecs != nullptr && sortSpecs->SpecsDirty) {
+                std::vector<BookmarkSortSpec> specs;
+                for (int i = 0; i < sortSpecs->SpecsCount; i++) {
+                    BookmarkSortSpec spec;
+                    spec.key = (BookmarkSortKey)sortSpecs->Specs[i].ColumnUserID;
+                    spec.descending = (sortSpecs->Specs[i].SortDirection == ImGuiSortDirection_Descending);
+                    specs.push_back(spec);
                 }
+                _this->sortedBookmarks.setSpecs(specs);
+                sortSpecs->SpecsDirty = false;
+                // Force scroll to selected bookmark
+                _this->scrollToClickedBookmark = true;
+            }
+
+            // The on air column needs the schedule even with the overlay off
+            _this->updateSchedule();
+            _this->sortedBookmarks.refresh(_this->store, _this->schedule);
+
+            // Only the visible rows are submitted. A row scrolled to is always
+            // included so it can be centered.
+            const BookmarkStore& store = _this->store;
+            const std::vector<BookmarkId>& rows = _this->sortedBookmarks.ids();
+            int scrollRow = -1;
+            if (_this->scrollToClickedBookmark) {
+                auto it = std::find_if(rows.begin(), rows.end(), [_this](BookmarkId id) { return _this->selection.contains(id); });
+                if (it != rows.end()) { scrollRow = it - rows.begin(); }
+                _this->scrollToClickedBookmark = false;
             }
 
-            for (auto& [name, bm] : _this->sortedBookmarks) {
-                ImGui::TableNextRow();
-                ImGui::TableSetColumnIndex(0);
-
-                FrequencyBookmark& cbm = _this->bookmarks[name];
-                if (ImGui::Selectable((name + "##_freq_mgr_bkm_name_" + _this->name).c_str(), &cbm.selected, ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_SelectOnClick)) {
-                    // if shift or control isn't pressed, deselect all others
-                    if (!ImGui::GetIO().KeyShift && !ImGui::GetIO().KeyCtrl) {
-                        for (auto& [_name, _bm] : _this->bookmarks) {
-                            if (name == _name) {
-                                continue; 
-                            }
-                            _bm.selected = false;
-                        }
+            ImGuiListClipper clipper;
+            clipper.Begin(rows.size());
+            if (scrollRow >= 0) { clipper.ForceDisplayRangeByIndices(scrollRow, scrollRow + 1); }
+            while (clipper.Step()) {
+                for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                    BookmarkId id = rows[row];
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::PushID((int)id);
+
+                    if (ImGui::Selectable(store.name(id), _this->selection.contains(id), ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_SelectOnClick)) {
+                        _this->clickBookmark(id);
+                    }
+                    if (ImGui::TableGetHoveredColumn() >= 0 && ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
+                        applyBookmark(store.get(id), gui::waterfall.selectedVFO);
+                        _this->selection.add(id);
                     }
-                }
-                if (ImGui::TableGetHoveredColumn() >= 0 && ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
-                    applyBookmark(bm, gui::waterfall.selectedVFO);
-                    cbm.selected = true;
-                }
 
-                ImGui::TableSetColumnIndex(1);
-                ImGui::Text("%s %s", utils::formatFreq(bm.frequency).c_str(), demodModeList[bm.mode]);
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::TextUnformatted(_this->frequencyText(id));
+                    if (ImGui::TableSetColumnIndex(2)) {
+                        ImGui::TextUnformatted(demodModeList[store.mode(id)]);
+                    }
+                    if (ImGui::TableSetColumnIndex(3)) {
+                        ImGui::Text("%04d", store.startTime(id));
+                    }
+                    if (ImGui::TableSetColumnIndex(4)) {
+                        ImGui::TextUnformatted(_this->schedule.online(id) ? "Yes" : "No");
+                    }
+                    if (ImGui::TableSetColumnIndex(5)) {
+                        ImGui::TextUnformatted(store.getList(store.listOf(id)).name.c_str());
+                    }
 
-                if (_this->scrollToClickedBookmark && cbm.selected) {
-                    ImGui::SetScrollHereY(0.5f);
-                    _this->scrollToClickedBookmark = false;                   
+                    if (row == scrollRow) {
+                        ImGui::SetScrollHereY(0.5f);
+                    }
+                    ImGui::PopID();
                 }
             }
+            clipper.End();
             ImGui::EndTable();
         }
 
 
-        if (selectedNames.size() != 1 && _this->selectedListName != "") { style::beginDisabled(); }
+        if (selectedCount != 1 && _this->selectedListName != "") { style::beginDisabled(); }
         if (ImGui::Button(("Apply##_freq_mgr_apply_" + _this->name).c_str(), ImVec2(menuWidth, 0))) {
-            FrequencyBookmark& bm = _this->bookmarks[selectedNames[0]];
-            applyBookmark(bm, gui::waterfall.selectedVFO);
-            bm.selected = false;
+            BookmarkId id = _this->selection.ids()[0];
+            applyBookmark(_this->store.get(id), gui::waterfall.selectedVFO);
+            _this->selection.remove(id);
+        }
+        if (selectedCount != 1 && _this->selectedListName != "") { style::endDisabled(); }
+
+        if (_this->importer.running()) {
+            char importText[64];
+            snprintf(importText, sizeof(importText), "Importing... %zu bookmarks", _this->importer.parsed());
+            ImGui::ProgressBar(_this->importer.progress(), ImVec2(menuWidth, 0), importText);
         }
-        if (selectedNames.size() != 1 && _this->selectedListName != "") { style::endDisabled(); }
 
         //Draw import and export buttons
         ImGui::BeginTable(("freq_manager_bottom_btn_table" + _this->name).c_str(), 2);
         ImGui::TableNextRow();
 
         ImGui::TableSetColumnIndex(0);
-        if (ImGui::Button(("Import##_freq_mgr_imp_" + _this->name).c_str(), ImVec2(ImGui::GetContentRegionAvail().x, 0)) && !_this->importOpen) {
+        if (_this->importer.running()) {
+            if (ImGui::Button(("Cancel##_freq_mgr_imp_" + _this->name).c_str(), ImVec2(ImGui::GetContentRegionAvail().x, 0))) {
+                _this->importer.cancel();
+            }
+        }
+        else if (ImGui::Button(("Import##_freq_mgr_imp_" + _this->name).c_str(), ImVec2(ImGui::GetContentRegionAvail().x, 0)) && !_this->importOpen) {
             _this->importOpen = true;
             _this->importDialog = new pfd::open_file("Import bookmarks", "", { "JSON Files (*.json)", "*.json", "All Files", "*" }, true);
         }
 
         ImGui::TableSetColumnIndex(1);
-        if (selectedNames.size() == 0 && _this->selectedListName != "") { style::beginDisabled(); }
+        if (selectedCount == 0 && _this->selectedListName != "") { style::beginDisabled(); }
         if (ImGui::Button(("Export##_freq_mgr_exp_" + _this->name).c_str(), ImVec2(ImGui::GetContentRegionAvail().x, 0)) && !_this->exportOpen) {
             _this->exportedBookmarks = json::object();
-            config.acquire();
-            for (auto& _name : selectedNames) {
-                _this->exportedBookmarks["bookmarks"][_name] = config.conf["lists"][_this->selectedListName]["bookmarks"][_name];
+            for (BookmarkId id : _this->selection.ids()) {
+                _this->exportedBookmarks["bookmarks"][_this->store.name(id)] = bookmarkToJson(_this->store.get(id));
             }
-            config.release();
             _this->exportOpen = true;
             _this->exportDialog = new pfd::save_file("Export bookmarks", "", { "JSON Files (*.json)", "*.json", "All Files", "*" }, true);
         }
-        if (selectedNames.size() == 0 && _this->selectedListName != "") { style::endDisabled(); }
+        if (selectedCount == 0 && _this->selectedListName != "") { style::endDisabled(); }
         ImGui::EndTable();
 
         if (ImGui::Button(("Select displayed lists##_freq_mgr_exp_" + _this->name).c_str(), ImVec2(menuWidth, 0))) {
@@ -887,40 +1364,80 @@ private:
         ImGui::LeftLabel("Bookmark display mode");
         ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
         if (ImGui::Combo(("##_freq_mgr_dms_" + _this->name).c_str(), &_this->bookmarkDisplayMode, bookmarkDisplayModesTxt)) {
-            config.acquire();
-            config.conf["bookmarkDisplayMode"] = _this->bookmarkDisplayMode;
-            config.release(true);
+            _this->saveSetting("bookmarkDisplayMode", _this->bookmarkDisplayMode);
         }
 
         ImGui::LeftLabel("Rows of bookmarks");
         ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
         if (ImGui::Combo(("##_freq_mgr_rob_" + _this->name).c_str(), &_this->bookmarkRows, bookmarkRowsTxt)) {
-            config.acquire();
-            config.conf["bookmarkRows"] = _this->bookmarkRows;
-            config.release(true);
+            _this->saveSetting("bookmarkRows", _this->bookmarkRows);
         }
 
         if (ImGui::Checkbox(("Rectangles##_freq_mgr_rect_" + _this->name).c_str(), &_this->bookmarkRectangle)) {
-            config.acquire();
-            config.conf["bookmarkRectangle"] = _this->bookmarkRectangle;
-            config.release(true);
+            _this->saveSetting("bookmarkRectangle", _this->bookmarkRectangle);
         }
 
         ImGui::SameLine();
         if (ImGui::Checkbox(("Centered##_freq_mgr_cen_" + _this->name).c_str(), &_this->bookmarkCentered)) {
-            config.acquire();
-            config.conf["bookmarkCentered"] = _this->bookmarkCentered;
-            config.release(true);
+            _this->saveSetting("bookmarkCentered", _this->bookmarkCentered);
         }
 
         if (ImGui::Checkbox(("Avoid clutter on last row##_freq_mgr_noClut_" + _this->name).c_str(), &_this->bookmarkNoClutter)) {
-            config.acquire();
-            config.conf["bookmarkNoClutter"] = _this->bookmarkNoClutter;
-            config.release(true);
+            _this->saveSetting("bookmarkNoClutter", _this->bookmarkNoClutter);
+        }
+
+        if (ImGui::Checkbox(("Group crowded bookmarks##_freq_mgr_clusters_" + _this->name).c_str(), &_this->bookmarkClusters)) {
+            _this->saveSetting("bookmarkClusters", _this->bookmarkClusters);
+        }
+
+        if (ImGui::Checkbox(("Hide bookmarks not on air##_freq_mgr_hide_offline_" + _this->name).c_str(), &_this->hideOffline)) {
+            _this->saveSetting("hideOffline", _this->hideOffline);
+            _this->updateOverlayFilter();
+        }
+
+        ImGui::LeftLabel("Frame budget (ms)");
+        ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+        if (ImGui::SliderFloat(("##_freq_mgr_budget_" + _this->name).c_str(), &_this->overlayBudget, 0.0f, 5.0f, "%.1f")) {
+            _this->governor.setBudget(_this->overlayBudget);
+            _this->saveSetting("overlayBudget", _this->overlayBudget);
+        }
+        if (_this->governor.detail() != DETAIL_FULL) {
+            ImGui::Text("Reduced detail: %s", overlayDetailName(_this->governor.detail()));
         }
 
         if (_this->selectedListName == "") { style::endDisabled(); }
 
+        if (ImGui::CollapsingHeader(("Waterfall filter##_freq_mgr_wf_filter_" + _this->name).c_str())) {
+            _this->overlayFilterMenu(menuWidth);
+        }
+
+        if (ImGui::CollapsingHeader(("Search##_freq_mgr_search_" + _this->name).c_str())) {
+            _this->searchMenu(menuWidth);
+        }
+
+#ifdef BOOKMARK_MANAGER_DIAGNOSTICS
+        if (ImGui::CollapsingHeader(("Diagnostics##_freq_mgr_diag_" + _this->name).c_str())) {
+            diag::draw(_this->name);
+            ImGui::SameLine();
+            if (ImGui::Button(("Export CSV##_freq_mgr_diag_csv_" + _this->name).c_str())) {
+                std::string path = core::args["root"].s() + "/bookmark_manager_diagnostics.csv";
+                std::string error;
+                if (diag::exportCsv(path, error)) {
+                    flog::info("Diagnostics written to {0}", path);
+                }
+                else {
+                    flog::error("Could not export diagnostics: {0}", error);
+                }
+            }
+
+            // Worked out only while shown, the search index walks all its postings
+            ImGui::Text("Store: %zu KB", _this->store.memoryUsage() / 1024);
+            ImGui::Text("Search index: %zu KB", _this->searchIndex.memoryUsage() / 1024);
+            ImGui::Text("Overlay filter: %zu KB", _this->bookmarkFilter.memoryUsage() / 1024);
+            ImGui::Text("Clusters: %zu KB", _this->clusters.memoryUsage() / 1024);
+        }
+#endif
+
         if (_this->createOpen) {
             _this->createOpen = _this->bookmarkEditDialog();
         }
@@ -963,124 +1480,158 @@ private:
     static void fftRedraw(ImGui::WaterFall::FFTRedrawArgs args, void* ctx) {
         BookmarkManagerModule* _this = (BookmarkManagerModule*)ctx;
         if (_this->bookmarkDisplayMode == BOOKMARK_DISP_MODE_OFF) { return; }
+        DIAG_SCOPE(diag::TIMER_FFT_REDRAW);
+        DIAG_ALLOCATIONS(diag::COUNTER_RENDER_ALLOCATIONS);
+        auto frameStart = std::chrono::steady_clock::now();
+
+        // Only bookmarks with a due on/off transition get evaluated again
+        _this->updateSchedule();
+        _this->updateLabelMetrics();
+        _this->updateShownBookmarks();
+
+        // The settings, less detailed while the overlay goes over its time budget
+        OverlayDetail detail = _this->governor.detail();
+        OverlayOptions options;
+        options.top = (_this->bookmarkDisplayMode == BOOKMARK_DISP_MODE_TOP);
+        options.rows = _this->bookmarkRows;
+        options.rectangle = _this->bookmarkRectangle && detail < DETAIL_NO_RECTANGLES;
+        options.centered = _this->bookmarkCentered;
+        options.noClutter = _this->bookmarkNoClutter;
+        options.fontSize = ImGui::GetFontSize();
+        measureDigits(options, ImGui::GetFont());
+        options.text = detail < DETAIL_NO_TEXT;
+        options.ticks = detail >= DETAIL_TICKS;
+        if (options.ticks) {
+            options.rows = 0;
+            options.noClutter = true;
+        }
+        bool clustered = _this->bookmarkClusters || detail >= DETAIL_CLUSTERS;
+
+        // Only redo the layout when something that affects it has changed,
+        // otherwise replay the commands from the previous frame
+        OverlayLayoutKey key;
+        key.lowFreq = args.lowFreq;
+        key.highFreq = args.highFreq;
+        key.minX = args.min.x;
+        key.minY = args.min.y;
+        key.maxX = args.max.x;
+        key.maxY = args.max.y;
+        key.fontSize = ImGui::GetFontSize();
+        key.displayMode = _this->bookmarkDisplayMode;
+        key.rows = options.rows;
+        key.rectangle = options.rectangle;
+        key.centered = options.centered;
+        key.noClutter = options.noClutter;
+        key.clusters = clustered;
+        key.detail = detail;
+        key.generation = _this->shownGeneration;
+        key.scheduleGeneration = _this->schedule.generation();
+
+        OverlayView view;
+        view.min = args.min;
+        view.max = args.max;
+        view.lowFreq = args.lowFreq;
+        view.highFreq = args.highFreq;
+        view.freqToPixelRatio = args.freqToPixelRatio;
+
+        // The clusters follow the shown bookmarks, rebuilt only when they changed
+        if (clustered && _this->clusterGeneration != _this->shownGeneration) {
+            _this->clusters.build(_this->store, *_this->shownBookmarks);
+            _this->clusterGeneration = _this->shownGeneration;
+        }
+        _this->updateOverlaySnapshot(clustered);
+
+        // Drawn, in order of preference: the worker's layout of this view, the
+        // last synchronous layout of this view, the worker's layout of a view
+        // panned a little since, shifted into place, and when none of these
+        // fit, a layout made right here.
+        if (_this->layoutWorker.acquire()) {
+            DIAG_RECORD(diag::TIMER_LAYOUT_LATENCY, _this->layoutWorker.front()->latency);
+        }
+        const OverlayFrame* frame = _this->layoutWorker.front();
+        float frameOffset = NAN;
+        if (frame && frame->snapshot == _this->overlaySnapshot && frame->schedule == _this->overlayStates && frame->options == options) {
+            frameOffset = panOffset(frame->view, view);
+        }
 
-        
-#ifdef _WIN32
-        std::vector<BookmarkRectangle> bookmarkRectangles[MAX_LINES];
-#else
-        std::vector<BookmarkRectangle> bookmarkRectangles[_this->bookmarkRows+1];
-#endif
-
-        int now = getUTCTime();
-        int weekDay = getWeekDay();
-
-        for (auto &bm : _this->waterfallBookmarks) {
-            double centerXpos = args.min.x + std::round((bm.bookmark.frequency - args.lowFreq) * args.freqToPixelRatio);
-
-            if (bm.bookmark.frequency >= args.lowFreq && bm.bookmark.frequency <= args.highFreq) {
-                ImVec2 nameSize = ImGui::CalcTextSize(bm.bookmarkName.c_str());
-
-                int row = 0;
-                double bmMinX = 0.0;
-                double bmMaxX = 0.0;
-                if (_this->bookmarkCentered) {
-                    bmMinX = centerXpos - (nameSize.x / 2) - 5;
-                    bmMaxX = centerXpos + (nameSize.x / 2) + 5;
-                } else {
-                    bmMinX = centerXpos - 5;
-                    bmMaxX = centerXpos + nameSize.x + 5;
-                }
-                // std::cout << "BR_X: " << bm.bookmarkName << " " << bmMinX << " " << bmMaxX << std::endl;
-                bool foundOnrow = false;
-                for (int i = 0; i < _this->bookmarkRows; i++) {
-                    foundOnrow = false;
-                    for (auto const br: bookmarkRectangles[i]) {
-                        if (((bmMinX >= br.min && bmMinX <= br.max) || (bmMaxX >= br.min && bmMaxX <= br.max)) || (br.max <= bmMaxX && br.min >= bmMinX)) {
-                            row = i + 1;
-                            foundOnrow = true;
-                            break;
-                        }
-                    }
-                    if (foundOnrow == false) {
-                        row = i;
-                        break; 
-                    }
-                }
-                // avoid clutter on the last row
-                if (row == _this->bookmarkRows && _this->bookmarkNoClutter) {
-                   foundOnrow = false;
-                    for (auto const br: bookmarkRectangles[row]) {
-                        if (((bmMinX >= br.min && bmMinX <= br.max) || (bmMaxX >= br.min && bmMaxX <= br.max)) || (br.max <= bmMaxX && br.min >= bmMinX)) {
-                            foundOnrow = true;
-                            break;
-                        }
-                    }
-                    if (foundOnrow) { continue; }
-                }
-
-                ImVec2 rectMin, rectMax;
-
-                if (_this->bookmarkDisplayMode == BOOKMARK_DISP_MODE_TOP) {
-                    double bottomright = args.min.y + nameSize.y + (nameSize.y * row);
-                    rectMin = ImVec2(bmMinX, args.min.y + (nameSize.y * row));
-                    if (bottomright >= args.max.y) { continue; }
-                    rectMax = ImVec2(bmMaxX, bottomright);
-                } else {
-                    double topleft = args.max.y - nameSize.y - (nameSize.y * row);
-                    if (topleft <= args.min.y) { continue; }
-                    rectMin = ImVec2(bmMinX, topleft);
-                    rectMax = ImVec2(bmMaxX, args.max.y - (nameSize.y * row));
-                }
-
-                bm.clampedRectMin = ImVec2(std::clamp<double>(rectMin.x, args.min.x, args.max.x), rectMin.y);
-                bm.clampedRectMax = ImVec2(std::clamp<double>(rectMax.x, args.min.x, args.max.x), rectMax.y);
-
-                /* BookmarkRectangle br = {
-                    .min = bmMinX,
-                    .max = bmMaxX,
-                    .row = row
-                };*/
-                BookmarkRectangle br = { bmMinX, bmMaxX, row };
-
-                bookmarkRectangles[row].push_back(br);
+        _this->drawnOffset = 0.0f;
+        if (frameOffset == 0.0f) {
+            _this->drawnLayout = &frame->layout;
+        }
+        else if (_this->layoutValid && key == _this->layoutKey) {
+            _this->drawnLayout = &_this->overlay;
+        }
+        else if (std::fabs(frameOffset) <= (view.max.x - view.min.x) * MAX_STALE_PAN) {
+            _this->drawnLayout = &frame->layout;
+            _this->drawnOffset = frameOffset;
+            DIAG_COUNT(diag::COUNTER_STALE_FRAMES, 1);
+        }
+        else {
+            _this->overlay.layout(_this->schedule, *_this->shownBookmarks, *_this->shownIndex, view, options, clustered ? &_this->clusters : NULL);
+            _this->layoutKey = key;
+            _this->layoutValid = true;
+            _this->drawnLayout = &_this->overlay;
+            DIAG_COUNT(diag::COUNTER_SYNC_LAYOUTS, 1);
+        }
 
-                // ImU32 bookmarkColor = IM_COL32(255, 255, 0, 255);
-                ImU32 bookmarkColor = bm.color;
-                ImU32 bookmarkTextColor = IM_COL32(0, 0, 0, 255);
+        // Unless the worker's layout was exact, have it lay out this view for the next frames
+        if (frameOffset != 0.0f && !(_this->requestValid && key == _this->requestKey)) {
+            _this->layoutWorker.request(_this->overlaySnapshot, _this->overlayStates, view, options);
+            _this->requestKey = key;
+            _this->requestValid = true;
+        }
 
+        // Whichever layout it is, it was made from the shown bookmarks as they
+        // are now, so their names can be read from the store
+        const OverlayLayout* drawn = _this->drawnLayout;
+        _this->drawnEpoch = _this->store.idEpoch();
+        [[maybe_unused]] size_t drawCalls = drawn->draw(args.window->DrawList, _this->store, options.rectangle, _this->drawnOffset);
+        DIAG_COUNT(diag::COUNTER_DRAW_CALLS, drawCalls);
+        DIAG_COUNT(diag::COUNTER_VISIBLE_LABELS, drawn->commands().size());
+        DIAG_COUNT(diag::COUNTER_SKIPPED_LABELS, drawn->candidates() - drawn->commands().size());
+
+        double frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+        if (_this->governor.frame(frameMs)) {
+            DIAG_COUNT(diag::COUNTER_DETAIL_CHANGES, 1);
+        }
+    }
 
-                if (!bookmarkOnline(bm.bookmark, now, weekDay)) {
-                    bookmarkColor = IM_COL32(128, 128, 128, 255);
-                }
+    // Points the overlay at the waterfall bookmarks, or at those that pass the
+    // filter when there is one. The filter only runs again when the waterfall
+    // bookmarks, the filter or the on air states changed.
+    void updateShownBookmarks() {
+        bool filtered = overlayFilter.active();
+        if (filtered && filterGeneration != waterfallGeneration) {
+            bookmarkFilter.build(store, waterfallBookmarks);
+            filterGeneration = waterfallGeneration;
+        }
+        bool changed = (filtered != shownFiltered) || (shownWaterfall != waterfallGeneration);
+        if (filtered && bookmarkFilter.apply(store, schedule, waterfallBookmarks, overlayFilter)) {
+            changed = true;
+        }
+        if (changed) {
+            shownGeneration++;
+            shownFiltered = filtered;
+            shownWaterfall = waterfallGeneration;
+        }
+        shownBookmarks = filtered ? &bookmarkFilter.bookmarks() : &waterfallBookmarks;
+        shownIndex = filtered ? &bookmarkFilter.index() : &waterfallIndex;
+    }
 
-                if (_this->bookmarkRectangle) {
-                    args.window->DrawList->AddRectFilled(bm.clampedRectMin, bm.clampedRectMax, bookmarkColor);
-                } else {
-                    bookmarkTextColor = bookmarkColor;
-                }
-                
-                
-                
-                if (_this->bookmarkDisplayMode == BOOKMARK_DISP_MODE_TOP) {
-                    args.window->DrawList->AddLine(ImVec2(centerXpos, args.min.y + (nameSize.y * (row + 1))), ImVec2(centerXpos, args.max.y), bookmarkColor);
-                    if (_this->bookmarkCentered) {                        
-                        if (((centerXpos - (nameSize.x / 2)) >= args.min.x) && ((centerXpos + (nameSize.x / 2) <= args.max.x))) {
-                            args.window->DrawList->AddText(ImVec2(centerXpos - (nameSize.x / 2), args.min.y + (nameSize.y * row)), bookmarkTextColor, bm.bookmarkName.c_str());
-                        }
-                    } else {
-                        if (((bmMinX + 6) >= args.min.x) && ((bmMinX + nameSize.x) <= args.max.x)) {
-                            args.window->DrawList->AddText(ImVec2(bmMinX + 6, args.min.y + (nameSize.y * row)), bookmarkTextColor, bm.bookmarkName.c_str());
-                        }
-                    }
-                } else {
-                    args.window->DrawList->AddLine(ImVec2(centerXpos, args.min.y), ImVec2(centerXpos, args.max.y - (nameSize.y * (row + 1))), bookmarkColor);
-                    if (_this->bookmarkCentered) {
-                        args.window->DrawList->AddText(ImVec2(centerXpos - (nameSize.x / 2), args.max.y - nameSize.y - (nameSize.y * row)), bookmarkTextColor, bm.bookmarkName.c_str());
-                    } else {
-                        args.window->DrawList->AddText(ImVec2(bmMinX + 6, args.max.y - nameSize.y - (nameSize.y * row)), bookmarkTextColor, bm.bookmarkName.c_str());
-                    }
-                }
-            }
+    // Copies of the shown bookmarks and on air states for the layout worker,
+    // made again only when the originals change
+    void updateOverlaySnapshot(bool clustered) {
+        if (!overlaySnapshot || snapshotGeneration != shownGeneration || overlaySnapshot->useClusters != clustered) {
+            auto snapshot = std::make_shared<OverlaySnapshot>();
+            snapshot->bookmarks = *shownBookmarks;
+            snapshot->index = *shownIndex;
+            snapshot->useClusters = clustered;
+            if (clustered) { snapshot->clusters = clusters; }
+            overlaySnapshot = std::move(snapshot);
+            snapshotGeneration = shownGeneration;
+        }
+        if (!overlayStates || overlayStates->generation() != schedule.generation()) {
+            overlayStates = std::make_shared<const ScheduleEngine>(schedule.statesCopy());
         }
     }
 
@@ -1089,6 +1640,8 @@ private:
     static void fftInput(ImGui::WaterFall::InputHandlerArgs args, void* ctx) {
         BookmarkManagerModule* _this = (BookmarkManagerModule*)ctx;
         if (_this->bookmarkDisplayMode == BOOKMARK_DISP_MODE_OFF) { return; }
+        DIAG_SCOPE(diag::TIMER_FFT_INPUT);
+        DIAG_ALLOCATIONS(diag::COUNTER_RENDER_ALLOCATIONS);
 
         if (_this->mouseClickedInLabel) {
             if (!ImGui::IsMouseDown(ImGuiMouseButton_Left)) {
@@ -1099,19 +1652,18 @@ private:
         }
 
         // First check that the mouse clicked outside of any label. Also get the bookmark that's hovered
-        bool inALabel = false;
-        WaterfallBookmark hoveredBookmark;
-        std::string hoveredBookmarkName;
-
-        for (auto& bm : _this->waterfallBookmarks) {
-            if (bm.bookmark.frequency >= args.lowFreq && bm.bookmark.frequency <= args.highFreq) {
-                if (ImGui::IsMouseHoveringRect(bm.clampedRectMin, bm.clampedRectMax)) {
-                    inALabel = true;
-                    hoveredBookmark = bm;
-                    hoveredBookmarkName = bm.bookmarkName;
-                }
+        BookmarkId hovered = INVALID_BOOKMARK;
+        if (_this->drawnLayout) {
+            // In the coordinates of the view the drawn layout was made for
+            ImVec2 mouse = ImGui::GetMousePos();
+            size_t item = _this->drawnLayout->find(mouse.x - _this->drawnOffset, mouse.y);
+            // Once ids have been freed, the label may belong to a bookmark
+            // removed since it was drawn, its id to another one
+            if (item != LabelHitIndex::NONE && _this->drawnEpoch == _this->store.idEpoch()) {
+                hovered = (BookmarkId)item;
             }
         }
+        bool inALabel = (hovered != INVALID_BOOKMARK);
 
         // Check if mouse was already down
         if (ImGui::IsMouseClicked(ImGuiMouseButton_Left) && !inALabel) {
@@ -1129,111 +1681,106 @@ private:
 
         if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
             _this->mouseClickedInLabel = true;
-            applyBookmark(hoveredBookmark.bookmark, gui::waterfall.selectedVFO);
+            applyBookmark(_this->store.get(hovered), gui::waterfall.selectedVFO);
             /* if the clicked list is different from the selected, switch */
-            if (hoveredBookmark.listName != _this->selectedListName) {
-                _this->loadByName(hoveredBookmark.listName);
-                _this->selectedListName = hoveredBookmark.listName;
-                config.acquire();
-                config.conf["selectedList"] = _this->selectedListName;
-                config.release(true);
+            if (_this->store.listOf(hovered) != _this->loadedList) {
+                _this->loadByName(_this->store.getList(_this->store.listOf(hovered)).name);
+                _this->saveSetting("selectedList", _this->selectedListName);
             }
-            /* search in _this->bookmarks the selected hoveredBookmark */
-            for (auto& [name, b] : _this->bookmarks) {
-                if (name == hoveredBookmarkName) {
-                    b.selected = true;
-                } else {
-                    b.selected = false;
-                }
-            }                
+            /* select only the hovered bookmark in the list */
+            _this->selection.clear();
+            _this->selection.add(hovered);
+            _this->selection.anchor = hovered;
             _this->scrollToClickedBookmark = true;
         }
 
         char bookmarkDays[8];
         bookmarkDays[7] = 0;
 
+        const BookmarkStore& store = _this->store;
         for (int i = 0; i < 7; i++) {
-            bookmarkDays[i] = hoveredBookmark.bookmark.days[i] ? 49 + i : '-';
+            bookmarkDays[i] = ((store.days(hovered) >> i) & 1) ? 49 + i : '-';
         }
 
         ImGui::BeginTooltip();
-        ImGui::TextUnformatted(hoveredBookmarkName.c_str());
+        ImGui::TextUnformatted(store.name(hovered));
         ImGui::Separator();
-        ImGui::Text("List: %s", hoveredBookmark.listName.c_str());
-        ImGui::Text("Frequency: %s", utils::formatFreq(hoveredBookmark.bookmark.frequency).c_str());
-        ImGui::Text("Bandwidth: %s", utils::formatFreq(hoveredBookmark.bookmark.bandwidth).c_str());
-        ImGui::Text("Start Time: %s", std::to_string(hoveredBookmark.bookmark.startTime).c_str());
-        ImGui::Text("End Time: %s", std::to_string(hoveredBookmark.bookmark.endTime).c_str());
+        ImGui::Text("List: %s", store.getList(store.listOf(hovered)).name.c_str());
+        _this->formatTooltip(hovered);
+        ImGui::Text("Frequency: %s", _this->tooltipFrequency.c_str());
+        ImGui::Text("Bandwidth: %s", _this->tooltipBandwidth.c_str());
+        ImGui::Text("Start Time: %d", store.startTime(hovered));
+        ImGui::Text("End Time: %d", store.endTime(hovered));
         ImGui::Text("Days: %s", bookmarkDays);
-        ImGui::Text("Mode: %s", demodModeList[hoveredBookmark.bookmark.mode]);
-        ImGui::Text("Geo info: %s", hoveredBookmark.bookmark.geoinfo.c_str());
-        ImGui::Text("Notes: %s", hoveredBookmark.bookmark.notes.c_str());
+        ImGui::Text("Mode: %s", demodModeList[store.mode(hovered)]);
+        ImGui::Text("Geo info: %s", store.geoinfo(hovered));
+        ImGui::Text("Notes: %s", store.notes(hovered));
         ImGui::EndTooltip();
     }
 
     json exportedBookmarks;
+    // Set when the bookmarks could not be loaded as saved, or edits can't be
+    // journaled
+    std::string storeWarning;
+
     bool importOpen = false;
     bool exportOpen = false;
     pfd::open_file* importDialog;
+    BookmarkImporter importer;
+    std::string importListName;
     pfd::save_file* exportDialog;
 
     void importBookmarks(std::string path) {
-        std::ifstream fs(path);
-        json importBookmarks;
-        fs >> importBookmarks;
+        // The file is parsed in the background, commitImport() adds the result
+        importListName = selectedListName;
+        importer.start(path);
+    }
+
+    void commitImport() {
+        BookmarkImporter::State result;
+        BookmarkImporter::Entries entries;
+        size_t skipped;
+        std::string error;
+        if (!importer.collect(result, entries, skipped, error)) { return; }
 
-        if (!importBookmarks.contains("bookmarks")) {
-            flog::error("File does not contains any bookmarks");
+        if (result == BookmarkImporter::IMPORT_CANCELLED) {
+            flog::info("Import cancelled");
             return;
         }
+        if (result == BookmarkImporter::IMPORT_FAILED) {
+            flog::error("{0}", error);
+            return;
+        }
+        if (skipped > 0) {
+            flog::warn("Skipped {0} invalid entries", skipped);
+        }
 
-        if (!importBookmarks["bookmarks"].is_object()) {
-            flog::error("Bookmark attribute is invalid");
+        ListId list = store.findList(importListName);
+        if (list == INVALID_LIST) {
+            flog::error("List '{0}' no longer exists, import discarded", importListName);
             return;
         }
 
-        int imported_entries = 0; 
-        // Load every bookmark
-        for (auto const [_name, bm] : importBookmarks["bookmarks"].items()) {
-            if (bookmarks.find(_name) != bookmarks.end()) {
-                flog::warn("Bookmark with the name '{0}' already exists in list, skipping", _name);
+        // When a name appears several times in the file the last entry wins
+        std::vector<std::pair<std::string, FrequencyBookmark>> newBookmarks;
+        std::unordered_set<std::string_view> seen;
+        size_t existing = 0;
+        for (auto it = entries.rbegin(); it != entries.rend(); it++) {
+            if (!seen.insert(it->first).second) { continue; }
+            if (store.find(list, it->first) != INVALID_BOOKMARK) {
+                existing++;
                 continue;
             }
-            FrequencyBookmark fbm;
-            fbm.frequency = bm["frequency"];
-            fbm.bandwidth = bm["bandwidth"];
-            fbm.startTime = bm.contains("startTime") ? (int)bm["startTime"] : 0;
-            fbm.endTime = bm.contains("endTime") ? (int)bm["endTime"] : 0;
-            
-            if (bm.contains("days")) {
-                std::copy(bm["days"].begin(), bm["days"].end(), fbm.days);
-            } else {
-                for (int i = 0; i < 7; i++) {
-                    fbm.days[i] = true;
-                }
-            }
-
-            if (bm.contains("geoinfo")) {
-                fbm.geoinfo = bm["geoinfo"];
-            } else {
-                fbm.geoinfo = "";
-            }
-
-            if (bm.contains("notes")) {
-                fbm.notes = bm["notes"];
-            } else {
-                fbm.notes = "";
-            }
-
-            fbm.mode = bm["mode"];
-            fbm.selected = false;
-            bookmarks[_name] = fbm;
-            imported_entries++;
+            newBookmarks.push_back(*it);
+        }
+        if (existing > 0) {
+            flog::warn("Skipped {0} bookmarks that already exist in the list", existing);
         }
-        saveByName(selectedListName);
-        fs.close();
 
-		flog::info("Imported {0} entries", imported_entries);
+        // All the entries go into the list at once
+        addBookmarks(list, newBookmarks);
+
+        flog::info("Imported {0} entries", newBookmarks.size());
     }
 
     void exportBookmarks(std::string path) {
@@ -1256,9 +1803,27 @@ private:
     EventHandler<ImGui::WaterFall::FFTRedrawArgs> fftRedrawHandler;
     EventHandler<ImGui::WaterFall::InputHandlerArgs> inputHandler;
 
-    std::map<std::string, FrequencyBookmark> bookmarks;
-    std::vector<std::pair<std::string, FrequencyBookmark>> sortedBookmarks;
-    bool sortSpecsDirty = true;
+    BookmarkStore store;
+    std::string dbPath;
+    std::string journalPath;
+    BookmarkPersistence persistence;
+
+    // Bookmarks of the list shown in the menu
+    ListId loadedList = INVALID_LIST;
+    SortedBookmarks sortedBookmarks;
+    SelectionSet selection;
+
+    struct FrequencyText {
+        double frequency;
+        int mode;
+        std::string text;
+    };
+    std::vector<FrequencyText> frequencyTexts;
+
+    BookmarkId tooltipBookmark = INVALID_BOOKMARK;
+    double tooltipValues[2];
+    std::string tooltipFrequency;
+    std::string tooltipBandwidth;
 
     std::string editedBookmarkName = "";
     std::string firstEditedBookmarkName = "";
@@ -1274,15 +1839,72 @@ private:
     ImVec4 editedListColor;
 
     std::vector<WaterfallBookmark> waterfallBookmarks;
+    FrequencyIndex waterfallIndex;
+    ScheduleEngine schedule;
+    int clockFrame = -1;
+    int64_t frameMinute = 0;
+    uint64_t waterfallGeneration = 0;
+    const ImFont* labelFont = NULL; // The waterfall bookmarks were measured with
+    float labelFontSize = 0.0f;
+
+    OverlayLayout overlay;
+    OverlayLayoutKey layoutKey;
+    bool layoutValid = false;
+    ClusterHierarchy clusters;
+    uint64_t clusterGeneration = UINT64_MAX;
+
+    // Layouts made off the UI thread, from snapshots of the bookmarks
+    OverlayWorker layoutWorker;
+    std::shared_ptr<const OverlaySnapshot> overlaySnapshot;
+    uint64_t snapshotGeneration = 0;
+    std::shared_ptr<const ScheduleEngine> overlayStates;
+    OverlayLayoutKey requestKey;
+    bool requestValid = false;
+
+    // Filter between the waterfall bookmarks and the overlay
+    bool hideOffline;
+    char filterName[256] = "";
+    int filterMode = 0; // Index into searchModesTxt, 0 for any
+    ListId filterList = INVALID_LIST;
+    double filterMinBandwidth = 0.0;
+    double filterMaxBandwidth = 0.0;
+    OverlayFilter overlayFilter;
+    BookmarkFilter bookmarkFilter;
+    uint64_t filterGeneration = UINT64_MAX; // waterfallGeneration the filter was built for
+
+    // What the overlay shows, the waterfall bookmarks or those that passed the filter
+    const std::vector<WaterfallBookmark>* shownBookmarks = NULL;
+    const FrequencyIndex* shownIndex = NULL;
+    uint64_t shownGeneration = 0;
+    uint64_t shownWaterfall = UINT64_MAX;
+    bool shownFiltered = false;
+
+    // What the last frame drew, for hit-testing
+    const OverlayLayout* drawnLayout = NULL;
+    float drawnOffset = 0.0f;
+    uint64_t drawnEpoch = 0; // Of the store when drawnLayout was drawn
 
     int bookmarkDisplayMode = 0;
     int bookmarkRows = 0;
     bool bookmarkRectangle;
     bool bookmarkCentered;
     bool bookmarkNoClutter;
-    int currentSortColumn = -1;
-    bool currentSortAscending = true;    
+    bool bookmarkClusters;
+    float overlayBudget; // ms per frame, 0 for no limit
+    FrameGovernor governor;
     bool scrollToClickedBookmark = false;
+
+    // Search across every list
+    SearchIndex searchIndex;
+    BookmarkSearch search;
+    char searchText[256] = "";
+    int searchMode = 0; // Index into searchModesTxt, 0 for any
+    double searchMinFrequency = 0.0;
+    double searchMaxFrequency = 0.0;
+    bool searchOnlineOnly = false;
+    bool searchDirty = false; // Set by edits, the results may be stale
+    uint64_t searchScheduleGeneration = 0;
+    BookmarkId searchSelected = INVALID_BOOKMARK;
 };
 
 MOD_EXPORT void _INIT_() {
@@ -1293,8 +1915,9 @@ MOD_EXPORT void _INIT_() {
     def["bookmarkRectangle"] = true;
     def["bookmarkCentered"] = true;
     def["bookmarkNoClutter"] = false;
-    def["lists"]["General"]["showOnWaterfall"] = true;
-    def["lists"]["General"]["bookmarks"] = json::object();
+    def["bookmarkClusters"] = false;
+    def["overlayBudget"] = 1.0;
+    def["hideOffline"] = false;
 
     config.setPath(core::args["root"].s() + "/bookmark_manager_config.json");
     config.load(def);
@@ -1317,7 +1940,21 @@ MOD_EXPORT void _INIT_() {
     if (!config.conf.contains("bookmarkNoClutter")) {
         config.conf["bookmarkNoClutter"] = false;
     }
+    if (!config.conf.contains("bookmarkClusters")) {
+        config.conf["bookmarkClusters"] = false;
+    }
+    if (!config.conf.contains("overlayBudget")) {
+        config.conf["overlayBudget"] = 1.0;
+    }
+    if (!config.conf.contains("hideOffline")) {
+        config.conf["hideOffline"] = false;
+    }
 
+    // Lists only remain in configs from before the bookmark database, they get moved to it on load
+    if (!config.conf.contains("lists")) {
+        config.release(true);
+        return;
+    }
     for (auto [listName, list] : config.conf["lists"].items()) {
         if (list.contains("bookmarks") && list.contains("showOnWaterfall") && list["showOnWaterfall"].is_boolean()) { continue; }
         json newList;
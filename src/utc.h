@@ -1,15 +0,0 @@
-/**
- * @file utc.h
- * @author your Otto Pattemore https://github.com/OttoPattemore/shortwave-station-list-sdrpp/
- * @brief 
- * @version 0.1
- * @date 2022-08-02
- * 
- * @copyright Copyright (c) Otto Pattemore 2022
- * 
- */
-#pragma once
-float getUTCTime();
-int getUTCHour();
-int getUTCMin();
-int getWeekDay();
@@ -0,0 +1,90 @@
+#include "test.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+    struct Case {
+        const char* suite;
+        const char* name;
+        void (*fn)();
+    };
+
+    std::vector<Case>& cases() {
+        static std::vector<Case> all;
+        return all;
+    }
+
+    int failures = 0;
+    bool updateGolden = false;
+    std::vector<std::string> tempFiles;
+}
+
+namespace test {
+    int add(const char* suite, const char* name, void (*fn)()) {
+        cases().push_back({ suite, name, fn });
+        return 0;
+    }
+
+    void fail(const char* file, int line, const std::string& message) {
+        fprintf(stderr, "%s:%d: %s\n", file, line, message.c_str());
+        failures++;
+    }
+
+    void golden(const char* file, int line, const std::string& name, const std::string& actual) {
+        std::string path = std::string(BOOKMARK_MANAGER_GOLDEN_DIR) + "/" + name + ".txt";
+        if (updateGolden) {
+            std::ofstream(path, std::ios::binary) << actual;
+            return;
+        }
+        std::ifstream in(path, std::ios::binary);
+        std::string expected((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (in && expected == actual) { return; }
+
+        // Left next to the test binary for diffing
+        std::string actualPath = name + ".actual.txt";
+        std::ofstream(actualPath, std::ios::binary) << actual;
+        fail(file, line, "output differs from " + path + ", got " + actualPath);
+    }
+
+    std::string tempPath(const std::string& name) {
+        std::string path = (std::filesystem::temp_directory_path() / ("bookmark_manager_test_" + name)).string();
+        std::filesystem::remove(path);
+        tempFiles.push_back(path);
+        return path;
+    }
+}
+
+// bookmark_manager_tests [--update-golden] [suite...], every suite if none is given
+int main(int argc, char** argv) {
+    std::vector<std::string> suites;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--update-golden")) {
+            updateGolden = true;
+            continue;
+        }
+        suites.push_back(argv[i]);
+    }
+
+    int ran = 0;
+    for (auto const& c : cases()) {
+        if (!suites.empty() && std::find(suites.begin(), suites.end(), c.suite) == suites.end()) { continue; }
+        int before = failures;
+        c.fn();
+        for (auto const& path : tempFiles) {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+        }
+        tempFiles.clear();
+        printf("%s %s.%s\n", (failures == before) ? "ok  " : "FAIL", c.suite, c.name);
+        ran++;
+    }
+    if (ran == 0) {
+        fprintf(stderr, "no tests to run\n");
+        return 1;
+    }
+    return failures ? 1 : 0;
+}
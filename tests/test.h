@@ -0,0 +1,36 @@
+#pragma once
+#include <exception>
+#include <sstream>
+#include <string>
+
+// Minimal test harness. Tests register under a suite, the runner is given
+// the suites to run and reports every failed check, not just the first one.
+namespace test {
+    int add(const char* suite, const char* name, void (*fn)());
+    void fail(const char* file, int line, const std::string& message);
+
+    // Compares `actual` with golden/<name>.txt, or rewrites that file when
+    // run with --update-golden
+    void golden(const char* file, int line, const std::string& name, const std::string& actual);
+
+    // Path of a scratch file, removed when the test ends
+    std::string tempPath(const std::string& name);
+
+    template <class A, class B>
+    void checkEqual(const char* file, int line, const char* expr, const A& a, const B& b) {
+        if (a == b) { return; }
+        std::ostringstream ss;
+        ss << expr << ": " << a << " != " << b;
+        fail(file, line, ss.str());
+    }
+}
+
+#define TEST(suite, name) \
+    static void test_##suite##_##name(); \
+    static int reg_##suite##_##name = test::add(#suite, #name, test_##suite##_##name); \
+    static void test_##suite##_##name()
+
+#define CHECK(cond) do { if (!(cond)) { test::fail(__FILE__, __LINE__, #cond); } } while (0)
+#define CHECK_EQ(a, b) test::checkEqual(__FILE__, __LINE__, #a " == " #b, (a), (b))
+#define CHECK_THROWS(expr) do { try { (void)(expr); test::fail(__FILE__, __LINE__, #expr " didn't throw"); } catch (const std::exception&) {} } while (0)
+#define CHECK_GOLDEN(name, actual) test::golden(__FILE__, __LINE__, name, actual)
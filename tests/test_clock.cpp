@@ -0,0 +1,65 @@
+#include "test.h"
+#include "utc.h"
+
+namespace {
+    // Monday 2024-01-01 00:00 UTC, in seconds since the Unix epoch
+    constexpr int64_t MONDAY = 28401120 * (int64_t)60;
+}
+
+TEST(clock, fromEpoch) {
+    UTCTime epoch = utc::fromEpoch(0);
+    CHECK_EQ(epoch.year, 1970);
+    CHECK_EQ(epoch.month, 1);
+    CHECK_EQ(epoch.day, 1);
+    CHECK_EQ(epoch.weekDay, 4);
+    CHECK_EQ(epoch.hhmm(), 0);
+
+    UTCTime time = utc::fromEpoch(MONDAY + 12 * 3600 + 34 * 60 + 56);
+    CHECK_EQ(time.year, 2024);
+    CHECK_EQ(time.month, 1);
+    CHECK_EQ(time.day, 1);
+    CHECK_EQ(time.hour, 12);
+    CHECK_EQ(time.minute, 34);
+    CHECK_EQ(time.second, 56);
+    CHECK_EQ(time.weekDay, 1);
+    CHECK_EQ(time.hhmm(), 1234);
+    CHECK_EQ(time.epochMinute(), MONDAY / 60 + 754);
+
+    // Last second of a leap day
+    UTCTime leap = utc::fromEpoch(1709251199);
+    CHECK_EQ(leap.month, 2);
+    CHECK_EQ(leap.day, 29);
+    CHECK_EQ(leap.hhmm(), 2359);
+    CHECK_EQ(leap.weekDay, 4);
+}
+
+TEST(clock, epochMinute) {
+    // Rounds down, also before the epoch
+    UTCTime time;
+    time.epochSeconds = 59;
+    CHECK_EQ(time.epochMinute(), 0);
+    time.epochSeconds = 60;
+    CHECK_EQ(time.epochMinute(), 1);
+    time.epochSeconds = -1;
+    CHECK_EQ(time.epochMinute(), -1);
+    time.epochSeconds = -60;
+    CHECK_EQ(time.epochMinute(), -1);
+    time.epochSeconds = -61;
+    CHECK_EQ(time.epochMinute(), -2);
+}
+
+TEST(clock, fakeClock) {
+    FakeClock clock(MONDAY);
+    utc::setClock(&clock);
+    CHECK_EQ(utc::now().epochSeconds, MONDAY);
+
+    clock.advance(90);
+    CHECK_EQ(utc::now().epochMinute(), MONDAY / 60 + 1);
+    clock.set(MONDAY - 1);
+    CHECK_EQ(utc::now().weekDay, 0);
+    CHECK_EQ(utc::now().hhmm(), 2359);
+
+    // Back to the system clock, which is well past 2024
+    utc::setClock(nullptr);
+    CHECK(utc::now().epochSeconds > MONDAY);
+}
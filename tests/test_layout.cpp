@@ -0,0 +1,231 @@
+#include "test.h"
+#include "overlay_layout.h"
+#include "bookmark_clusters.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// Layout output compared against golden files, so changes to the layout code
+// that move, drop or recolor labels show up as a diff
+
+namespace {
+    // Monday 2024-01-01 12:00 UTC. Bookmarks are on air all day, except for
+    // the one named "Offline", on air only at 0000.
+    constexpr int64_t EPOCH_MINUTE = 28401120 + 720;
+
+    struct Fixture {
+        BookmarkStore store;
+        ScheduleEngine schedule;
+        std::vector<WaterfallBookmark> bookmarks;
+        FrequencyIndex index;
+
+        void add(ListId list, const char* name, double frequency) {
+            FrequencyBookmark bm = {};
+            bm.frequency = frequency;
+            bm.bandwidth = 10000;
+            bm.startTime = 0;
+            bm.endTime = strcmp(name, "Offline") ? 0 : 1;
+            maskToDays(ALL_DAYS_MASK, bm.days);
+            store.add(list, name, bm);
+        }
+
+        void finish() {
+            schedule.update(store, EPOCH_MINUTE);
+            for (BookmarkId id = 0; id < store.capacity(); id++) {
+                ImVec2 nameSize = measureLabel(ImGui::GetFont(), ImGui::GetFontSize(), store.name(id));
+                bookmarks.push_back({ id, store.color(id), store.frequency(id), nameSize, (uint32_t)strlen(store.name(id)) });
+            }
+            std::sort(bookmarks.begin(), bookmarks.end(), [](const WaterfallBookmark& a, const WaterfallBookmark& b) {
+                return a.frequency < b.frequency;
+            });
+            for (auto const& wbm : bookmarks) {
+                index.push(wbm.frequency);
+            }
+        }
+    };
+
+    // A dozen labels of various lengths, some close enough to need stacking
+    void sparse(Fixture& f) {
+        ListId red = f.store.addList("Red", IM_COL32(255, 0, 0, 255), true);
+        ListId green = f.store.addList("Green", IM_COL32(0, 255, 0, 255), true);
+        f.add(red, "Alpha", 100200);
+        f.add(red, "Bravo Long Name", 100500);
+        f.add(green, "Charlie", 100700);
+        f.add(green, "Offline", 101000);
+        f.add(red, "Echo", 101050);
+        f.add(red, "Foxtrot", 101100);
+        f.add(green, "Golf", 101150);
+        f.add(green, "Hotel", 102500);
+        f.add(red, "India", 103800);
+        f.add(red, "Juliett", 103950);
+        f.add(green, "Outside", 99000);
+        f.finish();
+    }
+
+    // Runs of bookmarks a few Hz apart, for grouping
+    void crowded(Fixture& f) {
+        ListId red = f.store.addList("Red", IM_COL32(255, 0, 0, 255), true);
+        ListId green = f.store.addList("Green", IM_COL32(0, 255, 0, 255), true);
+        char name[16];
+        for (int i = 0; i < 40; i++) {
+            snprintf(name, sizeof(name), "R%d", i);
+            f.add((i % 3) ? red : green, name, 100500 + i * 2);
+        }
+        for (int i = 0; i < 5; i++) {
+            snprintf(name, sizeof(name), "S%d", i);
+            f.add(red, name, 103000 + i * 300);
+        }
+        f.finish();
+    }
+
+    // 400x100 pixels over 100-104 kHz, 0.1 pixel per Hz
+    OverlayView defaultView() {
+        OverlayView view;
+        view.min = ImVec2(0, 0);
+        view.max = ImVec2(400, 100);
+        view.lowFreq = 100000;
+        view.highFreq = 104000;
+        view.freqToPixelRatio = 0.1;
+        return view;
+    }
+
+    OverlayOptions defaultOptions() {
+        OverlayOptions options;
+        options.top = false;
+        options.rows = 2;
+        options.rectangle = true;
+        options.centered = false;
+        options.noClutter = false;
+        options.fontSize = ImGui::GetFontSize();
+        measureDigits(options, ImGui::GetFont());
+        return options;
+    }
+
+    std::string point(const ImVec2& p) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "(%.1f,%.1f)", p.x, p.y);
+        return buf;
+    }
+
+    // Text dump of everything the layout produced, its drawing and a hit test at each label
+    std::string dump(const BookmarkStore& store, const OverlayLayout& layout, bool rectangle) {
+        std::string out;
+        char buf[128];
+        for (auto const& cmd : layout.commands()) {
+            snprintf(buf, sizeof(buf), "label %s color=%08x text=%08x drawText=%d", store.name(cmd.id), cmd.color, cmd.textColor, cmd.drawText);
+            out += buf;
+            out += " rect=" + point(cmd.rectMin) + "-" + point(cmd.rectMax);
+            out += " line=" + point(cmd.lineStart) + "-" + point(cmd.lineEnd);
+            out += " textPos=" + point(cmd.textPos);
+            ImVec2 center((cmd.rectMin.x + cmd.rectMax.x) / 2, (cmd.rectMin.y + cmd.rectMax.y) / 2);
+            size_t hit = layout.find(center.x, center.y);
+            out += " hit=" + std::string((hit == LabelHitIndex::NONE) ? "none" : store.name((BookmarkId)hit)) + "\n";
+        }
+        for (auto const& cmd : layout.clusterCommands()) {
+            out += "cluster " + std::string(cmd.text);
+            out += " rect=" + point(cmd.rectMin) + "-" + point(cmd.rectMax);
+            out += " line=" + point(cmd.lineStart) + "-" + point(cmd.lineEnd);
+            out += " textPos=" + point(cmd.textPos) + " segments=";
+            for (int i = 0; i < cmd.segments; i++) {
+                snprintf(buf, sizeof(buf), "%s%08x@%.1f", i ? "," : "", cmd.segmentColors[i], cmd.segmentEnds[i]);
+                out += buf;
+            }
+            out += "\n";
+        }
+
+        ImDrawList drawList;
+        size_t calls = layout.draw(&drawList, store, rectangle);
+        snprintf(buf, sizeof(buf), "candidates=%zu calls=%zu rects=%zu lines=%zu texts=%zu glyphs=%zu growths=%zu\n",
+                 layout.candidates(), calls, drawList.rects, drawList.lines, drawList.texts, drawList.glyphs, drawList.growths);
+        out += buf;
+        return out;
+    }
+
+    std::string run(Fixture& f, const OverlayView& view, const OverlayOptions& options, const ClusterHierarchy* clusters = NULL) {
+        OverlayLayout layout;
+        layout.layout(f.schedule, f.bookmarks, f.index, view, options, clusters);
+        return dump(f.store, layout, options.rectangle);
+    }
+}
+
+TEST(layout, bottom) {
+    Fixture f;
+    sparse(f);
+    CHECK_GOLDEN("layout_bottom", run(f, defaultView(), defaultOptions()));
+}
+
+TEST(layout, topCentered) {
+    Fixture f;
+    sparse(f);
+    OverlayOptions options = defaultOptions();
+    options.top = true;
+    options.centered = true;
+    options.rows = 4;
+    CHECK_GOLDEN("layout_top_centered", run(f, defaultView(), options));
+}
+
+TEST(layout, noClutterOneRow) {
+    Fixture f;
+    sparse(f);
+    OverlayOptions options = defaultOptions();
+    options.rows = 0;
+    options.noClutter = true;
+    CHECK_GOLDEN("layout_no_clutter", run(f, defaultView(), options));
+}
+
+TEST(layout, textOnly) {
+    Fixture f;
+    sparse(f);
+    OverlayOptions options = defaultOptions();
+    options.rectangle = false;
+    options.text = true;
+    CHECK_GOLDEN("layout_text_only", run(f, defaultView(), options));
+}
+
+TEST(layout, ticks) {
+    Fixture f;
+    sparse(f);
+    OverlayOptions options = defaultOptions();
+    options.rectangle = false;
+    options.text = false;
+    options.ticks = true;
+    options.rows = 0;
+    options.noClutter = true;
+    CHECK_GOLDEN("layout_ticks", run(f, defaultView(), options));
+}
+
+TEST(layout, clustered) {
+    Fixture f;
+    crowded(f);
+    ClusterHierarchy clusters;
+    clusters.build(f.store, f.bookmarks);
+    CHECK_GOLDEN("layout_clustered", run(f, defaultView(), defaultOptions(), &clusters));
+}
+
+TEST(layout, panned) {
+    // A layout drawn shifted for a panned view lands where that view's own layout would
+    Fixture f;
+    sparse(f);
+    OverlayView view = defaultView();
+    OverlayView pannedView = view;
+    pannedView.lowFreq += 100;
+    pannedView.highFreq += 100;
+    float offset = panOffset(view, pannedView);
+    CHECK_EQ(offset, -10.0f);
+
+    OverlayView zoomed = view;
+    zoomed.highFreq += 100;
+    zoomed.freqToPixelRatio = 400.0 / 4100.0;
+    CHECK(std::isnan(panOffset(view, zoomed)));
+
+    OverlayLayout layout;
+    layout.layout(f.schedule, f.bookmarks, f.index, view, defaultOptions());
+    OverlayLayout pannedLayout;
+    pannedLayout.layout(f.schedule, f.bookmarks, f.index, pannedView, defaultOptions());
+    for (auto const& cmd : pannedLayout.commands()) {
+        auto it = std::find_if(layout.commands().begin(), layout.commands().end(), [&cmd](const LabelDrawCommand& c) { return c.id == cmd.id; });
+        if (it == layout.commands().end() || it->rectMin.y != cmd.rectMin.y) { continue; }
+        CHECK_EQ(it->lineStart.x + offset, cmd.lineStart.x);
+    }
+}
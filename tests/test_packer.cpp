@@ -0,0 +1,69 @@
+#include "test.h"
+#include "label_layout.h"
+
+namespace {
+    // Places a label the way the overlay layout does, returns its row
+    int place(RowPacker& packer, double min, double max) {
+        int row = packer.findRow(min);
+        if (row >= 0) { packer.occupy(row, max); }
+        return row;
+    }
+}
+
+TEST(packer, firstFreeRow) {
+    RowPacker packer;
+    packer.reset(2, false);
+    CHECK_EQ(place(packer, 0, 10), 0);
+    CHECK_EQ(place(packer, 5, 15), 1);
+    CHECK_EQ(place(packer, 8, 20), 2); // Overflow row
+    CHECK_EQ(place(packer, 12, 30), 0);
+    CHECK_EQ(place(packer, 16, 18), 1);
+    CHECK_EQ(place(packer, 25, 26), 1);
+    CHECK_EQ(place(packer, 26, 27), 2);
+}
+
+TEST(packer, touchingLabelsOverlap) {
+    // Extents are closed, a label starting on the right edge of another overlaps it
+    RowPacker packer;
+    packer.reset(1, false);
+    CHECK_EQ(place(packer, 0, 10), 0);
+    CHECK_EQ(place(packer, 10, 20), 1);
+    CHECK_EQ(place(packer, 10.5, 20), 0);
+}
+
+TEST(packer, noClutter) {
+    // Labels overlapping on the overflow row are skipped, the others still go there
+    RowPacker packer;
+    packer.reset(1, true);
+    CHECK_EQ(place(packer, 0, 10), 0);
+    CHECK_EQ(place(packer, 5, 15), 1);
+    CHECK_EQ(place(packer, 8, 20), -1);
+    CHECK_EQ(place(packer, 9, 12), -1);
+    CHECK_EQ(place(packer, 16, 20), 0);
+    CHECK_EQ(place(packer, 17, 30), 1);
+
+    // A skipped label doesn't take up space
+    packer.reset(0, true);
+    CHECK_EQ(place(packer, 0, 10), 0);
+    CHECK_EQ(place(packer, 5, 100), -1);
+    CHECK_EQ(place(packer, 11, 12), 0);
+}
+
+TEST(packer, noRows) {
+    // Without regular rows every label goes on the overflow row
+    RowPacker packer;
+    packer.reset(0, false);
+    CHECK_EQ(place(packer, 0, 10), 0);
+    CHECK_EQ(place(packer, 5, 15), 0);
+    packer.reset(-3, false);
+    CHECK_EQ(place(packer, 0, 10), 0);
+}
+
+TEST(packer, reset) {
+    RowPacker packer;
+    packer.reset(1, false);
+    CHECK_EQ(place(packer, 0, 10), 0);
+    CHECK_EQ(place(packer, 5, 15), 1);
+    packer.reset(1, false);
+    CHECK_EQ(place(packer, 5, 15), 0);
+}
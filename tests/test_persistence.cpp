@@ -0,0 +1,201 @@
+#include "test.h"
+#include "bookmark_db.h"
+#include "bookmark_journal.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+namespace {
+    FrequencyBookmark bookmark(double frequency, int mode, const char* notes = "", const char* geoinfo = "") {
+        FrequencyBookmark bm = {};
+        bm.frequency = frequency;
+        bm.bandwidth = 12500;
+        bm.mode = mode;
+        bm.startTime = 2200;
+        bm.endTime = 200;
+        maskToDays(0x55, bm.days);
+        bm.notes = notes;
+        bm.geoinfo = geoinfo;
+        return bm;
+    }
+
+    // Two lists with notes, non-ASCII names and a hole left by a removed bookmark
+    void fill(BookmarkStore& store) {
+        ListId general = store.addList("General", DEFAULT_LIST_COLOR, true);
+        ListId broadcast = store.addList("Broadcast", hexStrToColor("#12AB34"), false);
+        store.add(general, "Tower", bookmark(118.1e6, 2, "ATIS", "EDDF"));
+        BookmarkId removed = store.add(general, "Removed", bookmark(120e6, 0));
+        store.add(broadcast, "R\xc3\xa1\x64io \xe6\x97\xa5\xe6\x9c\xac", bookmark(9.41e6, 2, "Line one\nline two"));
+        store.add(broadcast, "Empty notes", bookmark(6.07e6, 6));
+        store.remove(removed);
+    }
+
+    // Everything the JSON layout holds, for comparing stores
+    std::string content(const BookmarkStore& store) {
+        return storeToJson(store).dump();
+    }
+}
+
+TEST(persistence, databaseRoundTrip) {
+    BookmarkStore store;
+    fill(store);
+    std::string path = test::tempPath("round_trip.db");
+    std::string error;
+    CHECK(BookmarkDatabase::save(store, path, error, 42));
+
+    BookmarkStore loaded;
+    uint64_t sequence = 0;
+    CHECK(BookmarkDatabase::load(loaded, path, error, &sequence));
+    CHECK_EQ(error, "");
+    CHECK_EQ(sequence, 42u);
+    CHECK_EQ(loaded.size(), store.size());
+    CHECK_EQ(content(loaded), content(store));
+
+    // Saving what was loaded gives the same file
+    std::string again = test::tempPath("round_trip_again.db");
+    CHECK(BookmarkDatabase::save(loaded, again, error, 42));
+    std::ifstream a(path, std::ios::binary), b(again, std::ios::binary);
+    std::string bytesA((std::istreambuf_iterator<char>(a)), std::istreambuf_iterator<char>());
+    std::string bytesB((std::istreambuf_iterator<char>(b)), std::istreambuf_iterator<char>());
+    CHECK(bytesA == bytesB);
+}
+
+TEST(persistence, databaseRejectsDamage) {
+    BookmarkStore store;
+    fill(store);
+    std::string path = test::tempPath("damaged.db");
+    std::string error;
+    CHECK(BookmarkDatabase::save(store, path, error));
+
+    // Cut in half: the load fails and leaves the store as it was
+    std::ifstream in(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes.substr(0, bytes.size() / 2);
+
+    BookmarkStore loaded;
+    fill(loaded);
+    std::string before = content(loaded);
+    CHECK(!BookmarkDatabase::load(loaded, path, error));
+    CHECK(!error.empty());
+    CHECK_EQ(content(loaded), before);
+
+    error.clear();
+    CHECK(!BookmarkDatabase::load(loaded, test::tempPath("missing.db"), error));
+    CHECK(!error.empty());
+}
+
+TEST(persistence, journalReplay) {
+    std::string dbPath = test::tempPath("journal.db");
+    std::string journalPath = test::tempPath("journal.journal");
+    std::string error;
+
+    // Start from a saved database, then journal edits while applying them
+    BookmarkStore store;
+    fill(store);
+    CHECK(BookmarkDatabase::save(store, dbPath, error));
+    BookmarkStore base = store;
+
+    EditJournal journal;
+    size_t replayed = 0;
+    CHECK(journal.open(journalPath, store, 0, replayed, error));
+    CHECK_EQ(replayed, 0u);
+
+    journal.addList("Utility", 0xFF0000FF, true);
+    ListId utility = store.addList("Utility", 0xFF0000FF, true);
+    journal.addBookmark("Utility", "Volmet", bookmark(5.45e6, 6));
+    store.add(utility, "Volmet", bookmark(5.45e6, 6));
+    journal.updateBookmark("General", "Tower", "Tower 2", bookmark(118.2e6, 2, "changed"));
+    store.update(store.find(store.findList("General"), "Tower"), "Tower 2", bookmark(118.2e6, 2, "changed"));
+    journal.renameList("Broadcast", "Shortwave");
+    store.renameList(store.findList("Broadcast"), "Shortwave");
+    journal.setListShown("Shortwave", true);
+    store.setListShown(store.findList("Shortwave"), true);
+    journal.removeBookmark("Shortwave", "Empty notes");
+    store.remove(store.find(store.findList("Shortwave"), "Empty notes"));
+    uint64_t afterEdits = journal.sequence();
+    CHECK(journal.sync());
+    journal.close();
+
+    // The database plus the journal give the edited store
+    BookmarkStore replayedStore;
+    uint64_t dbSequence = 0;
+    CHECK(BookmarkDatabase::load(replayedStore, dbPath, error, &dbSequence));
+    CHECK(journal.open(journalPath, replayedStore, dbSequence, replayed, error));
+    CHECK_EQ(replayed, 6u);
+    CHECK_EQ(content(replayedStore), content(store));
+    journal.close();
+
+    // A database written after the edits skips them on replay
+    CHECK(BookmarkDatabase::save(store, dbPath, error, afterEdits));
+    BookmarkStore compacted;
+    CHECK(BookmarkDatabase::load(compacted, dbPath, error, &dbSequence));
+    CHECK(journal.open(journalPath, compacted, dbSequence, replayed, error));
+    CHECK_EQ(replayed, 0u);
+    CHECK_EQ(content(compacted), content(store));
+    journal.close();
+
+    // A torn last record, as left by a crash mid-write, is dropped
+    std::ofstream(journalPath, std::ios::binary | std::ios::app) << std::string("\x20\x00\x00\x00garbage", 11);
+    BookmarkStore torn = base;
+    CHECK(journal.open(journalPath, torn, 0, replayed, error));
+    CHECK_EQ(replayed, 6u);
+    CHECK_EQ(content(torn), content(store));
+    journal.close();
+
+    // A journal that isn't one at all is kept aside, not overwritten
+    std::string badPath = test::tempPath("journal.journal.bad");
+    std::ofstream(journalPath, std::ios::binary | std::ios::trunc) << "not a journal";
+    BookmarkStore unread = base;
+    error.clear();
+    CHECK(journal.open(journalPath, unread, 0, replayed, error));
+    CHECK_EQ(replayed, 0u);
+    CHECK(!error.empty());
+    CHECK_EQ(content(unread), content(base));
+    std::ifstream kept(badPath, std::ios::binary);
+    CHECK_EQ(std::string(std::istreambuf_iterator<char>(kept), {}), "not a journal");
+    journal.close();
+}
+
+TEST(persistence, jsonRoundTrip) {
+    BookmarkStore store;
+    fill(store);
+    json lists = storeToJson(store);
+
+    BookmarkStore loaded;
+    storeFromJson(loaded, lists);
+    CHECK_EQ(loaded.size(), store.size());
+    CHECK(storeToJson(loaded) == lists);
+
+    // Through text too, as written to bookmark_manager_lists.json
+    BookmarkStore parsed;
+    storeFromJson(parsed, json::parse(lists.dump(4)));
+    CHECK(storeToJson(parsed) == lists);
+
+    FrequencyBookmark bm = bookmark(7.2e6, 7, "n", "g");
+    FrequencyBookmark back = bookmarkFromJson(bookmarkToJson(bm));
+    CHECK_EQ(back.frequency, bm.frequency);
+    CHECK_EQ(back.bandwidth, bm.bandwidth);
+    CHECK_EQ(back.mode, bm.mode);
+    CHECK_EQ(back.startTime, bm.startTime);
+    CHECK_EQ(back.endTime, bm.endTime);
+    CHECK_EQ(daysToMask(back.days), daysToMask(bm.days));
+    CHECK_EQ(back.notes, bm.notes);
+    CHECK_EQ(back.geoinfo, bm.geoinfo);
+
+    // Out of range entries are rejected instead of overrunning days or the
+    // mode names
+    json bad = bookmarkToJson(bm);
+    bad["days"].push_back(true);
+    CHECK_THROWS(bookmarkFromJson(bad));
+    bad["days"] = true;
+    CHECK_THROWS(bookmarkFromJson(bad));
+    bad = bookmarkToJson(bm);
+    bad["mode"] = BOOKMARK_MODE_COUNT;
+    CHECK_THROWS(bookmarkFromJson(bad));
+    bad["mode"] = -1;
+    CHECK_THROWS(bookmarkFromJson(bad));
+
+    CHECK_EQ(colorToHexStr(hexStrToColor("#12AB34")), "#12AB34");
+    CHECK_EQ(hexStrToColor("not a color"), DEFAULT_LIST_COLOR);
+}
@@ -0,0 +1,161 @@
+#include "test.h"
+#include "schedule.h"
+#include "utc.h"
+
+namespace {
+    // Monday 2024-01-01 00:00 UTC, in minutes since the Unix epoch
+    constexpr int64_t MONDAY = 28401120;
+    constexpr int64_t DAY = 1440;
+
+    constexpr uint8_t SUNDAY_BIT = 1 << 0;
+    constexpr uint8_t MONDAY_BIT = 1 << 1;
+    constexpr uint8_t TUESDAY_BIT = 1 << 2;
+
+    // Minute of `hhmm` on the day `day` days after that Monday
+    int64_t at(int day, int hhmm) {
+        return MONDAY + day * DAY + (hhmm / 100) * 60 + hhmm % 100;
+    }
+
+    FrequencyBookmark scheduled(double frequency, int startTime, int endTime, uint8_t days) {
+        FrequencyBookmark bm = {};
+        bm.frequency = frequency;
+        bm.bandwidth = 10000;
+        bm.startTime = startTime;
+        bm.endTime = endTime;
+        maskToDays(days, bm.days);
+        return bm;
+    }
+}
+
+TEST(schedule, timeValid) {
+    CHECK(timeValid(0));
+    CHECK(timeValid(2359));
+    CHECK(!timeValid(2400));
+    CHECK(!timeValid(60));
+    CHECK(!timeValid(-1));
+}
+
+TEST(schedule, allDay) {
+    // 0000-0000 is on air for the whole of every selected day
+    CHECK(bookmarkOnlineAt(0, 0, MONDAY_BIT, at(0, 0)));
+    CHECK(bookmarkOnlineAt(0, 0, MONDAY_BIT, at(0, 1200)));
+    CHECK(bookmarkOnlineAt(0, 0, MONDAY_BIT, at(0, 2359)));
+    CHECK(!bookmarkOnlineAt(0, 0, MONDAY_BIT, at(1, 0)));
+    CHECK(!bookmarkOnlineAt(0, 0, MONDAY_BIT, at(-1, 2359)));
+
+    CHECK_EQ(nextScheduleTransition(0, 0, MONDAY_BIT, at(0, 1200)), at(1, 0));
+    CHECK_EQ(nextScheduleTransition(0, 0, MONDAY_BIT, at(1, 0)), at(7, 0));
+    CHECK_EQ(nextScheduleTransition(0, 0, ALL_DAYS_MASK, at(0, 1200)), NEVER);
+    CHECK_EQ(nextScheduleTransition(0, 0, 0, at(0, 1200)), NEVER);
+}
+
+TEST(schedule, window) {
+    // The start minute is included, the end minute is not
+    CHECK(!bookmarkOnlineAt(800, 1000, ALL_DAYS_MASK, at(0, 759)));
+    CHECK(bookmarkOnlineAt(800, 1000, ALL_DAYS_MASK, at(0, 800)));
+    CHECK(bookmarkOnlineAt(800, 1000, ALL_DAYS_MASK, at(0, 959)));
+    CHECK(!bookmarkOnlineAt(800, 1000, ALL_DAYS_MASK, at(0, 1000)));
+
+    CHECK_EQ(nextScheduleTransition(800, 1000, ALL_DAYS_MASK, at(0, 700)), at(0, 800));
+    CHECK_EQ(nextScheduleTransition(800, 1000, ALL_DAYS_MASK, at(0, 800)), at(0, 1000));
+    CHECK_EQ(nextScheduleTransition(800, 1000, ALL_DAYS_MASK, at(0, 1000)), at(1, 800));
+    CHECK_EQ(nextScheduleTransition(800, 1000, TUESDAY_BIT, at(0, 1000)), at(1, 800));
+}
+
+TEST(schedule, overnight) {
+    // A window past midnight is checked against the day of the current
+    // minute, and its end minute is included
+    CHECK(!bookmarkOnlineAt(2200, 200, ALL_DAYS_MASK, at(0, 2159)));
+    CHECK(bookmarkOnlineAt(2200, 200, ALL_DAYS_MASK, at(0, 2200)));
+    CHECK(bookmarkOnlineAt(2200, 200, ALL_DAYS_MASK, at(0, 2359)));
+    CHECK(bookmarkOnlineAt(2200, 200, ALL_DAYS_MASK, at(1, 0)));
+    CHECK(bookmarkOnlineAt(2200, 200, ALL_DAYS_MASK, at(1, 200)));
+    CHECK(!bookmarkOnlineAt(2200, 200, ALL_DAYS_MASK, at(1, 201)));
+
+    // Monday only: on from Monday 0000 to 0200 and from 2200 to midnight
+    CHECK(bookmarkOnlineAt(2200, 200, MONDAY_BIT, at(0, 100)));
+    CHECK(bookmarkOnlineAt(2200, 200, MONDAY_BIT, at(0, 2300)));
+    CHECK(!bookmarkOnlineAt(2200, 200, MONDAY_BIT, at(1, 100)));
+
+    CHECK_EQ(nextScheduleTransition(2200, 200, ALL_DAYS_MASK, at(0, 2200)), at(1, 201));
+    CHECK_EQ(nextScheduleTransition(2200, 200, MONDAY_BIT, at(0, 2200)), at(1, 0));
+    CHECK_EQ(nextScheduleTransition(2200, 200, MONDAY_BIT | SUNDAY_BIT, at(-1, 2300)), at(0, 201));
+}
+
+TEST(schedule, neverOnAir) {
+    // Equal start and end times other than 0000 never go on air
+    CHECK(!bookmarkOnlineAt(1200, 1200, ALL_DAYS_MASK, at(0, 1200)));
+    CHECK(!bookmarkOnlineAt(1200, 1200, ALL_DAYS_MASK, at(0, 1159)));
+    CHECK_EQ(nextScheduleTransition(1200, 1200, ALL_DAYS_MASK, at(0, 0)), NEVER);
+}
+
+TEST(schedule, engineMatchesScan) {
+    // Every minute of a week, the engine must agree with evaluating each bookmark
+    BookmarkStore store;
+    ListId list = store.addList("List", DEFAULT_LIST_COLOR, true);
+    store.add(list, "allDay", scheduled(1e6, 0, 0, MONDAY_BIT | TUESDAY_BIT));
+    store.add(list, "window", scheduled(2e6, 800, 1000, ALL_DAYS_MASK));
+    store.add(list, "overnight", scheduled(3e6, 2200, 200, MONDAY_BIT | SUNDAY_BIT));
+    store.add(list, "never", scheduled(4e6, 1200, 1200, ALL_DAYS_MASK));
+    store.add(list, "minute", scheduled(5e6, 1234, 1235, TUESDAY_BIT));
+
+    ScheduleEngine engine;
+    int mismatches = 0;
+    for (int64_t minute = at(-1, 0); minute < at(7, 0); minute++) {
+        engine.update(store, minute);
+        for (BookmarkId id = 0; id < store.capacity(); id++) {
+            bool expected = bookmarkOnlineAt(store.startTime(id), store.endTime(id), store.days(id), minute);
+            mismatches += (engine.online(id) != expected);
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+
+    // Edits take effect on the next update
+    FrequencyBookmark bm = scheduled(4e6, 0, 0, ALL_DAYS_MASK);
+    BookmarkId id = store.find(list, "never");
+    store.update(id, "never", bm);
+    engine.invalidate(id);
+    engine.update(store, at(7, 0));
+    CHECK(engine.online(id));
+}
+
+TEST(schedule, fakeClock) {
+    // Driven the way the module does it: one clock reading per frame
+    BookmarkStore store;
+    ListId list = store.addList("List", DEFAULT_LIST_COLOR, true);
+    BookmarkId id = store.add(list, "window", scheduled(2e6, 800, 1000, MONDAY_BIT));
+
+    FakeClock clock(at(0, 759) * 60 + 30);
+    utc::setClock(&clock);
+    ScheduleEngine engine;
+
+    engine.update(store, utc::now().epochMinute());
+    CHECK(!engine.online(id));
+    uint64_t generation = engine.generation();
+
+    // Half a minute later the window has started
+    clock.advance(30);
+    engine.update(store, utc::now().epochMinute());
+    CHECK(engine.online(id));
+    CHECK(engine.generation() != generation);
+
+    // Nothing changes within the window
+    generation = engine.generation();
+    clock.advance(3600);
+    engine.update(store, utc::now().epochMinute());
+    CHECK(engine.online(id));
+    CHECK_EQ(engine.generation(), generation);
+
+    // Off at 1000 until the next Monday
+    clock.set(at(0, 1000) * 60);
+    engine.update(store, utc::now().epochMinute());
+    CHECK(!engine.online(id));
+    clock.set(at(1, 900) * 60);
+    engine.update(store, utc::now().epochMinute());
+    CHECK(!engine.online(id));
+    clock.set(at(7, 800) * 60);
+    engine.update(store, utc::now().epochMinute());
+    CHECK(engine.online(id));
+
+    utc::setClock(nullptr);
+}